@@ -11,6 +11,9 @@ const MAX_DEVICES = 15;
 const SAVE_DEBOUNCE_MS = 600;
 const THEME_STORAGE_KEY = "theme";
 const DEVICE_ACTION_ENDPOINT = "/device/action";
+const LIVE_ENDPOINT = "/live";
+const STATUS_POLL_MS = 1000;
+const STATUS_LIVE_POLL_MS = 30000;
 
 function setHtmlTheme(theme) {
   const isDark = theme === "dark";
@@ -372,9 +375,40 @@ function App() {
     loadConfig();
     loadStatus();
 
-    const interval = setInterval(loadStatus, 1000);
+    let interval = setInterval(loadStatus, STATUS_POLL_MS);
+    let source = null;
+
+    function pollStatusEvery(ms) {
+      clearInterval(interval);
+      interval = setInterval(loadStatus, ms);
+    }
+
+    if (typeof EventSource === "function") {
+      source = new EventSource(LIVE_ENDPOINT);
+      source.onopen = () => {
+        // Readings are pushed as they are collected, /status only refreshes the rest.
+        pollStatusEvery(STATUS_LIVE_POLL_MS);
+      };
+      source.onmessage = (event) => {
+        try {
+          const sample = JSON.parse(event.data);
+          setStatus((prev) => ({ ...(prev || {}), devices: sample.devices }));
+          setIsLive(true);
+        } catch (error) {
+          console.error(error);
+        }
+      };
+      source.onerror = () => {
+        // Poll until the browser reconnects, or for good if the device turned us away.
+        pollStatusEvery(STATUS_POLL_MS);
+      };
+    }
+
     return () => {
       clearInterval(interval);
+      if (source) {
+        source.close();
+      }
       clearTimeout(saveTimerRef.current);
     };
   }, []);
@@ -4,20 +4,25 @@
 
 #include "auramon.h"
 
-uint8_t findAvailableAddressLocked() {
-    bool used[MAX_DEVICES + 1] = {};
+int findAvailableChannelLocked() {
     for (uint8_t i = 0; i < MAX_DEVICES; i++) {
-        if (!deviceInfos[i]) {
-            continue;
+        if (deviceInfos[i] == nullptr) {
+            return i;
         }
-        uint8_t addr = deviceInfos[i]->addr;
-        if (addr >= 1 && addr <= MAX_DEVICES) {
-            used[addr] = true;
+    }
+    return -1;
+}
+
+uint8_t findAvailableAddressLocked() {
+    bool used[248] = {};
+    for (uint8_t i = 0; i < MAX_DEVICES; i++) {
+        if (deviceInfos[i]) {
+            used[deviceInfos[i]->addr] = true;
         }
     }
 
-    for (uint8_t addr = 1; addr <= MAX_DEVICES; addr++) {
-        if (!used[addr] && deviceInfos[addr - 1] == nullptr) {
+    for (uint8_t addr = 1; addr <= 247; addr++) {
+        if (!used[addr]) {
             return addr;
         }
     }
@@ -31,21 +36,20 @@ uint32_t addDeviceFromButton(void *param) {
     uint8_t address = 0;
 
     mutex_enter_blocking(&deviceInfoMu);
-    address = findAvailableAddressLocked();
-    if (address == 0) {
+    const int channel = findAvailableChannelLocked();
+    if (channel < 0) {
         mutex_exit(&deviceInfoMu);
         LOGI("No free device slots available");
         return 0;
     }
-
-    size_t idx = static_cast<size_t>(address - 1);
-    if (deviceInfos[idx] != nullptr) {
+    address = findAvailableAddressLocked();
+    if (address == 0) {
         mutex_exit(&deviceInfoMu);
-        LOGI("Device slot already in use for address %u", address);
+        LOGI("No free device addresses available");
         return 0;
     }
 
-    auto info = new inputDeviceInfo(address);
+    auto info = new inputDeviceInfo(channel, address);
     info->enabled = true;
     char nameBuf[24];
     if (snprintf(nameBuf, sizeof(nameBuf), "Device %u", address) > 0) {
@@ -53,22 +57,19 @@ uint32_t addDeviceFromButton(void *param) {
     } else {
         info->name = strdup("Device");
     }
-    deviceInfos[idx] = info;
-    devicesChanged = true;
+    deviceInfos[channel] = info;
 
     mutex_exit(&deviceInfoMu);
 
+    configChanged();
+
     if (auto err = saveConfig(); err) {
         LOGE("Failed to save config after button add: %s", err->Error());
     }
 
-    if (!mutex_enter_block_until(&deviceActionMu, 100)) {
-        LOGE("Button add: could not acquire deviceActionMu");
-        return 0;
+    if (!sendDeviceAction({deviceActionType::Assign, address, 0, 0})) {
+        LOGE("Button add: too many pending actions");
     }
 
-    deviceActionControl = {deviceActionType::Assign, address};
-    mutex_exit(&deviceActionMu);
-
     return 0;
 }
@@ -6,90 +6,161 @@
 
 #include <Updater.h>
 #include <LittleFS.h>
+#include <WiFiServer.h>
 
 const char *contentTypeJSON PROGMEM = "application/json";
 const char *contentTypePlain PROGMEM = "text/plain";
 const char *contentTypeHTML PROGMEM = "text/html";
 const char *contentTypeCSV PROGMEM = "text/csv";
+const char *contentTypeEnergy PROGMEM = "application/vnd.auramon.energy";
+
+void returnOK(httpRequest &req, httpResponse &res);
+void handleGetConfig(httpRequest &req, httpResponse &res);
+void handlePostConfig(httpRequest &req, httpResponse &res);
+void handleStatus(httpRequest &req, httpResponse &res);
+void handleLive(httpRequest &req, httpResponse &res);
+void handleEnergy(httpRequest &req, httpResponse &res);
+void handleLogs(httpRequest &req, httpResponse &res);
+void handleNotFound(httpRequest &req, httpResponse &res);
+void handleOtaFinish(httpRequest &req, httpResponse &res);
+void handleOtaUpload(httpRequest &req, httpUpload &upload);
+void handlePublicUploadFinish(httpRequest &req, httpResponse &res);
+void handlePublicUpload(httpRequest &req, httpUpload &upload);
+void handleDeviceAction(httpRequest &req, httpResponse &res);
+void handleDeviceScan(httpRequest &req, httpResponse &res);
+void handleMetrics(httpRequest &req, httpResponse &res);
+void handleReboot(httpRequest &req, httpResponse &res);
+
+static WiFiServer listener(80);
+
+// clientSocket adapts a lwIP client to the HTTP server. Reads and writes
+// only move what the stack has ready, so they never wait.
+class clientSocket : public httpSocket {
+public:
+    explicit clientSocket(const WiFiClient &client) : _client(client) {
+    }
 
-void returnOK();
-void handleGetConfig();
-void handlePostConfig();
-void handleStatus();
-void handleEnergy();
-void handleLogs();
-void handleNotFound();
-void handleOtaFinish();
-void handleOtaUpload();
-void handlePublicUploadFinish();
-void handlePublicUpload();
-void handleDeviceAction();
-void handleMetrics();
-void handleReboot();
+    size_t read(uint8_t *buf, size_t len) override {
+        const int avail = _client.available();
+        if (avail <= 0) {
+            return 0;
+        }
+        const int n = _client.read(buf, std::min(len, static_cast<size_t>(avail)));
+        return n > 0 ? n : 0;
+    }
+
+    size_t write(const uint8_t *buf, size_t len) override {
+        const size_t room = std::min(len, static_cast<size_t>(_client.availableForWrite()));
+        if (room == 0) {
+            return 0;
+        }
+        return _client.write(buf, room);
+    }
+
+    bool connected() override { return _client.connected() || _client.available(); }
+
+    void close() override { _client.stop(); }
+
+private:
+    WiFiClient _client;
+};
+
+httpSocket *acceptClient() {
+    WiFiClient client = listener.accept();
+    if (!client) {
+        return nullptr;
+    }
+    client.setNoDelay(true);
+    return new clientSocket(client);
+}
 
 void setupAPI() {
-    server.on("/config", HTTP_GET, handleGetConfig);
-    server.on("/config", HTTP_POST, handlePostConfig);
-    server.on("/status", HTTP_GET, handleStatus);
-    server.on("/energy", HTTP_GET, handleEnergy);
-    server.on("/device/action", HTTP_POST, handleDeviceAction);
-    server.on("/logs", HTTP_GET, handleLogs);
-    server.on("/ota", HTTP_POST, handleOtaFinish, handleOtaUpload);
-    server.on("/ota/public", HTTP_POST, handlePublicUploadFinish, handlePublicUpload);
-    server.on("/metrics", HTTP_GET, handleMetrics);
-    server.on("/reboot", HTTP_POST, handleReboot);
-    server.on("/readyz", HTTP_GET, returnOK);
-    server.on("/livez", HTTP_GET, returnOK);
+    server.on("/config", httpMethod::Get, handleGetConfig);
+    server.on("/config", httpMethod::Post, handlePostConfig);
+    server.on("/status", httpMethod::Get, handleStatus);
+    server.on("/live", httpMethod::Get, handleLive);
+    server.on("/energy", httpMethod::Get, handleEnergy);
+    server.on("/device/action", httpMethod::Post, handleDeviceAction);
+    server.on("/device/scan", httpMethod::Get, handleDeviceScan);
+    server.on("/logs", httpMethod::Get, handleLogs);
+    server.on("/ota", httpMethod::Post, handleOtaFinish, handleOtaUpload);
+    server.on("/ota/public", httpMethod::Post, handlePublicUploadFinish, handlePublicUpload);
+    server.on("/metrics", httpMethod::Get, handleMetrics);
+    server.on("/reboot", httpMethod::Post, handleReboot);
+    server.on("/readyz", httpMethod::Get, returnOK);
+    server.on("/livez", httpMethod::Get, returnOK);
 
     server.onNotFound(handleNotFound); // Serve "public" from SD Card.
-    server.enableCORS(true);
-    server.enableCrossOrigin(true);
+
+    listener.begin();
 }
 
-void returnOK() {
-    server.send(200, contentTypePlain, "");
+void returnOK(httpRequest &req, httpResponse &res) {
+    res.send(200, contentTypePlain, "");
 }
 
-void returnInternalError(const char *reason) {
+void returnInternalError(httpResponse &res, const char *reason) {
     String msg = "{\"error\":\"Internal Error\",\"reason\":\"";
     msg.concat(reason);
     msg.concat("\"}");
-    server.send(500, contentTypeJSON, msg);
+    res.send(500, contentTypeJSON, msg);
+}
+
+// argUint returns a numeric query parameter, def if it is missing.
+uint32_t argUint(const httpRequest &req, const char *name, uint32_t def) {
+    const char *v = req.arg(name);
+    return v ? strtoul(v, nullptr, 10) : def;
 }
 
+// Request handlers build their JSON documents in this arena instead of the
+// heap. Handlers run one at a time on core 0 and their documents are gone
+// when they return, so the arena is free again after every request.
+constexpr size_t jsonArenaSize = 8192;
+
+alignas(arenaAlign) static uint8_t jsonArenaBuf[jsonArenaSize];
+static arena                       requestArena(jsonArenaBuf, sizeof(jsonArenaBuf));
+
+// arenaAllocator hands the request arena to ArduinoJson.
+class arenaAllocator : public ArduinoJson::Allocator {
+public:
+    void *allocate(size_t size) override { return requestArena.allocate(size); }
+    void  deallocate(void *ptr) override { requestArena.deallocate(ptr); }
+    void *reallocate(void *ptr, size_t newSize) override { return requestArena.reallocate(ptr, newSize); }
+};
+
+static arenaAllocator jsonArena;
+
 struct deviceColumn {
     uint8_t index;
     String  name;
 };
 
-void appendCSVValue(String &row, double value, const uint8_t precision = 3) {
-    row += ",";
-    if (std::isfinite(value)) {
-        row += String(value, precision);
-    }
+// appendFixed adds value with precision decimals, nothing if it is not finite.
+void appendFixed(String &out, double value, const uint8_t precision) {
+    char         buf[formatFixedSize];
+    const size_t n = formatFixed(buf, value, precision);
+    out.concat(buf, n);
 }
 
-void handleGetConfig() {
-    JsonDocument doc;
+void handleGetConfig(httpRequest &req, httpResponse &res) {
+    JsonDocument doc(&jsonArena);
     saveConfigJSON(doc);
 
     String response;
     serializeJson(doc, response);
 
-    server.send(200, contentTypeJSON, response);
+    res.send(200, contentTypeJSON, response);
 }
 
-void handlePostConfig() {
-    if (server.hasArg("plain") == false) {
-        server.send(400, contentTypeJSON, F("{\"error\":\"No data provided\"}"));
+void handlePostConfig(httpRequest &req, httpResponse &res) {
+    if (!req.body) {
+        res.send(400, contentTypeJSON, F("{\"error\":\"No data provided\"}"));
         return;
     }
 
-    String body = server.arg("plain");
-
-    JsonDocument doc;
-    if (auto err = deserializeJson(doc, body); err) {
-        server.send(400, contentTypeJSON, F("{\"error\":\"Invalid JSON\"}"));
+    JsonDocument doc(&jsonArena);
+    if (auto err = deserializeJson(doc, req.body, req.bodyLen); err) {
+        res.send(400, contentTypeJSON, F("{\"error\":\"Invalid JSON\"}"));
         return;
     }
 
@@ -98,89 +169,242 @@ void handlePostConfig() {
         String msg = "{\"error\":\"Invalid configuration\",\"reason\":\"";
         msg.concat(err->Error());
         msg.concat("\"}");
-        server.send(400, contentTypeJSON, msg);
+        res.send(400, contentTypeJSON, msg);
         return;
     }
 
     err = saveConfig();
     if (err) {
-        returnInternalError(err->Error());
+        returnInternalError(res, err->Error());
         return;
     }
 
-    mutex_enter_blocking(&deviceInfoMu);
-    devicesChanged = true;
-    mutex_exit(&deviceInfoMu);
+    configChanged();
 
-    server.send(200, contentTypePlain, "");
+    res.send(200, contentTypePlain, "");
 }
 
-void handleDeviceAction() {
-    if (server.hasArg("plain") == false) {
-        server.send(400, contentTypeJSON, F("{\"error\":\"No data provided\"}"));
+void handleDeviceAction(httpRequest &req, httpResponse &res) {
+    if (!req.body) {
+        res.send(400, contentTypeJSON, F("{\"error\":\"No data provided\"}"));
         return;
     }
 
-    String body = server.arg("plain");
-
-    JsonDocument doc;
-    if (auto err = deserializeJson(doc, body); err) {
-        server.send(400, contentTypeJSON, F("{\"error\":\"Invalid JSON\"}"));
+    JsonDocument doc(&jsonArena);
+    if (auto err = deserializeJson(doc, req.body, req.bodyLen); err) {
+        res.send(400, contentTypeJSON, F("{\"error\":\"Invalid JSON\"}"));
         return;
     }
 
-    if (!doc["action"].is<const char *>() || !doc["address"].is<uint32_t>()) {
-        server.send(400, contentTypeJSON, F("{\"error\":\"Invalid action payload\"}"));
+    if (!doc["action"].is<const char *>()) {
+        res.send(400, contentTypeJSON, F("{\"error\":\"Invalid action payload\"}"));
         return;
     }
 
     const char *     actionStr = doc["action"].as<const char *>();
-    uint32_t         address = doc["address"].as<uint32_t>();
+    uint32_t         address = 0;
+    uint32_t         bus = 0;
     deviceActionType action = deviceActionType::None;
 
     if (strcmp(actionStr, "locate") == 0) {
         action = deviceActionType::Locate;
     } else if (strcmp(actionStr, "assign") == 0) {
         action = deviceActionType::Assign;
+    } else if (strcmp(actionStr, "negotiate") == 0) {
+        action = deviceActionType::Negotiate;
+    } else if (strcmp(actionStr, "scan") == 0) {
+        action = deviceActionType::Scan;
     } else {
-        server.send(400, contentTypeJSON, F("{\"error\":\"Unknown action\"}"));
+        res.send(400, contentTypeJSON, F("{\"error\":\"Unknown action\"}"));
         return;
     }
 
-    if (address == 0 || address > MAX_DEVICES) {
-        server.send(400, contentTypeJSON, F("{\"error\":\"Invalid address\"}"));
-        return;
+    if (action == deviceActionType::Locate || action == deviceActionType::Assign) {
+        if (!doc["address"].is<uint32_t>()) {
+            res.send(400, contentTypeJSON, F("{\"error\":\"Invalid action payload\"}"));
+            return;
+        }
+
+        address = doc["address"].as<uint32_t>();
+        if (address == 0 || address > 247) {
+            res.send(400, contentTypeJSON, F("{\"error\":\"Invalid address\"}"));
+            return;
+        }
     }
 
-    if (!mutex_enter_block_until(&deviceActionMu, 100)) {
-        returnInternalError("could not acquire deviceInfoMu");
-        return;
+    if (!doc["bus"].isNull()) {
+        if (!doc["bus"].is<uint32_t>() || doc["bus"].as<uint32_t>() >= MODBUS_BUSES) {
+            res.send(400, contentTypeJSON, F("{\"error\":\"Invalid bus\"}"));
+            return;
+        }
+        bus = doc["bus"].as<uint32_t>();
     }
 
-    if (deviceActionControl.type != deviceActionType::None) {
-        mutex_exit(&deviceActionMu);
-        server.send(409, contentTypeJSON, F("{\"error\":\"Action already pending\"}"));
+    if (!sendDeviceAction({action, static_cast<uint8_t>(address), static_cast<uint8_t>(bus), 0})) {
+        res.send(503, contentTypeJSON, F("{\"error\":\"Too many pending actions\"}"));
         return;
     }
 
-    deviceActionControl = {action, static_cast<uint8_t>(address)};
+    res.send(202, contentTypeJSON, F("{\"status\":\"queued\"}"));
+}
 
-    mutex_exit(&deviceActionMu);
+void handleDeviceScan(httpRequest &req, httpResponse &res) {
+    if (!mutex_enter_block_until(&scanMu, 100)) {
+        returnInternalError(res, "could not acquire scanMu");
+        return;
+    }
+    const busScan result = scanResult;
+    mutex_exit(&scanMu);
+
+    JsonDocument doc(&jsonArena);
+    switch (result.state) {
+        case scanState::Running:
+            doc["state"] = "running";
+            break;
+        case scanState::Done:
+            doc["state"] = "done";
+            break;
+        default:
+            doc["state"] = "idle";
+            break;
+    }
+    doc["bus"] = result.bus;
+    doc["next"] = result.next;
+    doc["timeoutMs"] = result.timeoutMs;
+    doc["tookMs"] = result.tookMs;
+
+    JsonArray found = doc["found"].to<JsonArray>();
+    for (uint16_t addr = 1; addr <= 247; addr++) {
+        if (result.isFound(addr)) {
+            found.add(addr);
+        }
+    }
 
-    server.send(202, contentTypeJSON, F("{\"status\":\"queued\"}"));
+    String response;
+    serializeJson(doc, response);
+
+    res.send(200, contentTypeJSON, response);
 }
 
-void handleReboot() {
+void handleReboot(httpRequest &req, httpResponse &res) {
     LOGI("Reboot requested");
 
-    server.send(204, contentTypePlain, "");
+    res.send(204, contentTypePlain, "");
 
-    mutex_enter_blocking(&sdMu);
-    delay(100);
-    rp2040.reboot();
+    requestReboot();
+}
+
+void appendBusMetric(String &response, const __FlashStringHelper *name, uint8_t bus) {
+    response += name;
+    response += F("{bus=\"");
+    response += String(bus);
+    response += F("\"} ");
 }
 
-void handleMetrics() {
+void appendTaskMetric(String &response, const __FlashStringHelper *name, uint8_t core, const char *task) {
+    response += name;
+    response += F("{core=\"");
+    response += String(core);
+    response += F("\",task=\"");
+    response += task;
+    response += F("\"} ");
+}
+
+// appendTaskMetrics adds the scheduler stats of both cores.
+void appendTaskMetrics(String &response) {
+    const taskQueue *queues[] = {&c0Queue, &c1Queue};
+
+    response += F("# HELP auramon_task_runs_total Number of times the task ran.\n");
+    response += F("# TYPE auramon_task_runs_total counter\n");
+    for (uint8_t c = 0; c < 2; c++) {
+        for (uint8_t i = 0; i < queues[c]->statsCount(); i++) {
+            const taskStats &s = queues[c]->statsAt(i);
+            appendTaskMetric(response, F("auramon_task_runs_total"), c, s.name);
+            response += String(s.runs.load(std::memory_order_relaxed));
+            response += '\n';
+        }
+    }
+    response += F("# HELP auramon_task_run_seconds_total Total time spent running the task.\n");
+    response += F("# TYPE auramon_task_run_seconds_total counter\n");
+    for (uint8_t c = 0; c < 2; c++) {
+        for (uint8_t i = 0; i < queues[c]->statsCount(); i++) {
+            const taskStats &s = queues[c]->statsAt(i);
+            appendTaskMetric(response, F("auramon_task_run_seconds_total"), c, s.name);
+            appendFixed(response, s.runUS.load(std::memory_order_relaxed) / 1000000.0, 6);
+            response += '\n';
+        }
+    }
+    response += F("# HELP auramon_task_run_seconds_max Longest single run of the task.\n");
+    response += F("# TYPE auramon_task_run_seconds_max gauge\n");
+    for (uint8_t c = 0; c < 2; c++) {
+        for (uint8_t i = 0; i < queues[c]->statsCount(); i++) {
+            const taskStats &s = queues[c]->statsAt(i);
+            appendTaskMetric(response, F("auramon_task_run_seconds_max"), c, s.name);
+            appendFixed(response, s.maxUS.load(std::memory_order_relaxed) / 1000000.0, 6);
+            response += '\n';
+        }
+    }
+    response += F("# HELP auramon_task_lateness_seconds How late the task started after it was due.\n");
+    response += F("# TYPE auramon_task_lateness_seconds histogram\n");
+    for (uint8_t c = 0; c < 2; c++) {
+        for (uint8_t i = 0; i < queues[c]->statsCount(); i++) {
+            const taskStats &s = queues[c]->statsAt(i);
+            uint32_t         total = 0;
+            for (const auto &n: s.late) {
+                total += n.load(std::memory_order_relaxed);
+            }
+            // Work recorded outside the queue, like http, has no deadline.
+            if (total == 0) {
+                continue;
+            }
+
+            uint32_t count = 0;
+            for (uint8_t b = 0; b < taskLateBuckets; b++) {
+                count += s.late[b].load(std::memory_order_relaxed);
+                response += F("auramon_task_lateness_seconds_bucket{core=\"");
+                response += String(c);
+                response += F("\",task=\"");
+                response += s.name;
+                response += F("\",le=\"");
+                if (b < taskLateBuckets - 1) {
+                    appendFixed(response, taskLateBoundsMs[b] / 1000.0, 3);
+                } else {
+                    response += F("+Inf");
+                }
+                response += F("\"} ");
+                response += String(count);
+                response += '\n';
+            }
+            appendTaskMetric(response, F("auramon_task_lateness_seconds_sum"), c, s.name);
+            appendFixed(response, s.lateMs.load(std::memory_order_relaxed) / 1000.0, 3);
+            response += '\n';
+            appendTaskMetric(response, F("auramon_task_lateness_seconds_count"), c, s.name);
+            response += String(count);
+            response += '\n';
+        }
+    }
+
+    response += F("# HELP auramon_core_busy_seconds_total Time the core spent working.\n");
+    response += F("# TYPE auramon_core_busy_seconds_total counter\n");
+    for (uint8_t c = 0; c < 2; c++) {
+        response += F("auramon_core_busy_seconds_total{core=\"");
+        response += String(c);
+        response += F("\"} ");
+        appendFixed(response, queues[c]->load().busyUS.load(std::memory_order_relaxed) / 1000000.0, 3);
+        response += '\n';
+    }
+    response += F("# HELP auramon_core_idle_seconds_total Time the core spent waiting for work.\n");
+    response += F("# TYPE auramon_core_idle_seconds_total counter\n");
+    for (uint8_t c = 0; c < 2; c++) {
+        response += F("auramon_core_idle_seconds_total{core=\"");
+        response += String(c);
+        response += F("\"} ");
+        appendFixed(response, queues[c]->load().idleUS.load(std::memory_order_relaxed) / 1000000.0, 3);
+        response += '\n';
+    }
+}
+
+void handleMetrics(httpRequest &req, httpResponse &res) {
     const uint32_t errors = metrics.modbus_errors_total.load(std::memory_order_relaxed);
     const uint64_t totalMs = metrics.modbus_collect_time_ms_total.load(std::memory_order_relaxed);
     const uint32_t avgMs = metrics.modbus_last_run_avg_ms.load(std::memory_order_relaxed);
@@ -188,7 +412,7 @@ void handleMetrics() {
     const uint32_t datalogCacheHit = metrics.datalog_cache_hit.load(std::memory_order_relaxed);
 
     String response;
-    response.reserve(320);
+    response.reserve(2048 + MODBUS_BUSES * 256 + (c0Queue.statsCount() + c1Queue.statsCount()) * 1024);
     response += F("# HELP auramon_modbus_errors_total Total modbus collection errors.\n");
     response += F("# TYPE auramon_modbus_errors_total counter\n");
     response += F("auramon_modbus_errors_total ");
@@ -197,13 +421,13 @@ void handleMetrics() {
     response += F("# HELP auramon_collect_time_seconds_total Total time spent collecting data in seconds.\n");
     response += F("# TYPE auramon_collect_time_seconds_total counter\n");
     response += F("auramon_collect_time_seconds_total ");
-    response += String(totalMs / 1000.0, 6);
+    appendFixed(response, totalMs / 1000.0, 6);
     response += '\n';
     response += F(
         "# HELP auramon_collect_time_seconds_avg Average per-device collection time for the last run in seconds.\n");
     response += F("# TYPE auramon_collect_time_seconds_avg gauge\n");
     response += F("auramon_collect_time_seconds_avg ");
-    response += String(avgMs / 1000.0, 6);
+    appendFixed(response, avgMs / 1000.0, 6);
     response += '\n';
     response += F(
         "# HELP auramon_datalog_io Number of IO operations performed on the datalog.\n");
@@ -217,297 +441,612 @@ void handleMetrics() {
     response += F("auramon_datalog_cache_hit ");
     response += String(datalogCacheHit);
     response += '\n';
+    response += F("# HELP auramon_datalog_queue_depth Log records waiting to be written to the SD card.\n");
+    response += F("# TYPE auramon_datalog_queue_depth gauge\n");
+    response += F("auramon_datalog_queue_depth ");
+    response += String(logQueue.depth());
+    response += '\n';
+    response += F("# HELP auramon_datalog_queue_high_water Most log records that have waited at once.\n");
+    response += F("# TYPE auramon_datalog_queue_high_water gauge\n");
+    response += F("auramon_datalog_queue_high_water ");
+    response += String(logQueue.highWater());
+    response += '\n';
+    response += F("# HELP auramon_datalog_queue_dropped_total Log records dropped because the queue was full.\n");
+    response += F("# TYPE auramon_datalog_queue_dropped_total counter\n");
+    response += F("auramon_datalog_queue_dropped_total ");
+    response += String(logQueue.dropped());
+    response += '\n';
+    response += F("# HELP auramon_modbus_bus_baud Current baud rate of the modbus bus.\n");
+    response += F("# TYPE auramon_modbus_bus_baud gauge\n");
+    for (uint8_t b = 0; b < MODBUS_BUSES; b++) {
+        appendBusMetric(response, F("auramon_modbus_bus_baud"), b);
+        response += String(buses[b].stats.baud.load(std::memory_order_relaxed));
+        response += '\n';
+    }
+    response += F("# HELP auramon_modbus_bus_bytes_total Total bytes sent and received on the modbus bus.\n");
+    response += F("# TYPE auramon_modbus_bus_bytes_total counter\n");
+    for (uint8_t b = 0; b < MODBUS_BUSES; b++) {
+        appendBusMetric(response, F("auramon_modbus_bus_bytes_total"), b);
+        appendFixed(response, static_cast<double>(buses[b].stats.bytes.load(std::memory_order_relaxed)), 0);
+        response += '\n';
+    }
+    response += F(
+        "# HELP auramon_modbus_bus_throughput_bytes_per_second Achieved modbus throughput in the last collection run.\n");
+    response += F("# TYPE auramon_modbus_bus_throughput_bytes_per_second gauge\n");
+    for (uint8_t b = 0; b < MODBUS_BUSES; b++) {
+        appendBusMetric(response, F("auramon_modbus_bus_throughput_bytes_per_second"), b);
+        response += String(buses[b].stats.throughputBps.load(std::memory_order_relaxed));
+        response += '\n';
+    }
+    response += F("# HELP auramon_modbus_bus_collect_time_seconds Time taken to read every device on the bus in the last run.\n");
+    response += F("# TYPE auramon_modbus_bus_collect_time_seconds gauge\n");
+    for (uint8_t b = 0; b < MODBUS_BUSES; b++) {
+        appendBusMetric(response, F("auramon_modbus_bus_collect_time_seconds"), b);
+        appendFixed(response, buses[b].stats.lastRunMs.load(std::memory_order_relaxed) / 1000.0, 3);
+        response += '\n';
+    }
+    response += F("# HELP auramon_modbus_bus_fallbacks_total Number of times the modbus bus fell back to a slower speed.\n");
+    response += F("# TYPE auramon_modbus_bus_fallbacks_total counter\n");
+    for (uint8_t b = 0; b < MODBUS_BUSES; b++) {
+        appendBusMetric(response, F("auramon_modbus_bus_fallbacks_total"), b);
+        response += String(buses[b].stats.fallbacks.load(std::memory_order_relaxed));
+        response += '\n';
+    }
+
+    response += F("# HELP auramon_http_chunks_total Chunks sent in streamed responses.\n");
+    response += F("# TYPE auramon_http_chunks_total counter\n");
+    response += F("auramon_http_chunks_total ");
+    response += String(metrics.http_chunks_total.load(std::memory_order_relaxed));
+    response += '\n';
+    response += F("# HELP auramon_http_chunk_bytes_total Bytes sent in streamed response chunks.\n");
+    response += F("# TYPE auramon_http_chunk_bytes_total counter\n");
+    response += F("auramon_http_chunk_bytes_total ");
+    appendFixed(response, static_cast<double>(metrics.http_chunk_bytes_total.load(std::memory_order_relaxed)), 0);
+    response += '\n';
+    response += F("# HELP auramon_http_requests_total HTTP requests handled.\n");
+    response += F("# TYPE auramon_http_requests_total counter\n");
+    response += F("auramon_http_requests_total ");
+    response += String(metrics.http_requests_total.load(std::memory_order_relaxed));
+    response += '\n';
+    response += F("# HELP auramon_http_connections_total HTTP connections accepted.\n");
+    response += F("# TYPE auramon_http_connections_total counter\n");
+    response += F("auramon_http_connections_total ");
+    response += String(metrics.http_connections_total.load(std::memory_order_relaxed));
+    response += '\n';
+    response += F("# HELP auramon_live_clients Clients following /live.\n");
+    response += F("# TYPE auramon_live_clients gauge\n");
+    response += F("auramon_live_clients ");
+    response += String(liveClients());
+    response += '\n';
+    response += F("# HELP auramon_live_frames_total Samples encoded for /live clients.\n");
+    response += F("# TYPE auramon_live_frames_total counter\n");
+    response += F("auramon_live_frames_total ");
+    response += String(metrics.live_frames_total.load(std::memory_order_relaxed));
+    response += '\n';
+    response += F("# HELP auramon_http_arena_peak_bytes Most of the request arena ever in use.\n");
+    response += F("# TYPE auramon_http_arena_peak_bytes gauge\n");
+    response += F("auramon_http_arena_peak_bytes ");
+    response += String(requestArena.peak());
+    response += '\n';
+    response += F("# HELP auramon_http_arena_overflows_total Request allocations that did not fit the arena.\n");
+    response += F("# TYPE auramon_http_arena_overflows_total counter\n");
+    response += F("auramon_http_arena_overflows_total ");
+    response += String(requestArena.overflows());
+    response += '\n';
+    response += F("# HELP auramon_http_connections HTTP connections open.\n");
+    response += F("# TYPE auramon_http_connections gauge\n");
+    response += F("auramon_http_connections ");
+    response += String(server.connections());
+    response += '\n';
+
+    appendTaskMetrics(response);
 
-    server.send(200, contentTypePlain, response);
+    res.send(200, contentTypePlain, response);
 }
 
-void handleStatus() {
-    JsonDocument doc;
+// statusNetwork is the network section of /status, rebuilt only when an
+// address or the hostname changes.
+struct statusNetwork {
+    IPAddress ip;
+    IPAddress gateway;
+    IPAddress subnet;
+    IPAddress dns;
+    String    hostname;
+    String    json;
+};
 
-    doc["version"] = AURAMON_VERSION;
+static statusNetwork statusNet;
 
-    JsonObject statsObj = doc["stats"].to<JsonObject>();
-    statsObj["startTime"] = startTime;
-    statsObj["currentTime"] = time(nullptr);
-    statsObj["runSeconds"] = time(nullptr) - startTime;
-    statsObj["heapFree"] = rp2040.getFreeHeap();
+const String &networkStatusJSON() {
+    const IPAddress ip = eth.localIP();
+    const IPAddress gateway = eth.gatewayIP();
+    const IPAddress subnet = eth.subnetMask();
+    const IPAddress dns = eth.dnsIP();
+    if (statusNet.json.length() > 0 && ip == statusNet.ip && gateway == statusNet.gateway &&
+        subnet == statusNet.subnet && dns == statusNet.dns && netCfg.hostname == statusNet.hostname) {
+        return statusNet.json;
+    }
 
+    statusNet.ip = ip;
+    statusNet.gateway = gateway;
+    statusNet.subnet = subnet;
+    statusNet.dns = dns;
+    statusNet.hostname = netCfg.hostname;
+
+    JsonDocument doc(&jsonArena);
+    doc["hostname"] = netCfg.hostname;
+    doc["ip"] = ip.toString();
+    doc["gateway"] = gateway.toString();
+    doc["subnet"] = subnet.toString();
+    doc["dns"] = dns.toString();
+    char mac_str[18];
+    sprintf_P(mac_str, PSTR("%02X:%02X:%02X:%02X:%02X:%02X"), mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    doc["mac"] = mac_str;
 
-    JsonArray devicesArr = doc["devices"].to<JsonArray>();
+    statusNet.json = "";
+    serializeJson(doc, statusNet.json);
+    return statusNet.json;
+}
 
-    mutex_enter_blocking(&deviceDataMu);
+// statusLog is the datalog section of /status, rebuilt when the log moves on.
+struct statusLog {
+    logStats stats;
+    String   json;
+};
 
-    for (uint8_t i = 0; i < MAX_DEVICES; i++) {
-        auto data = deviceData[i];
-        if (!data || !data->name || !data->name[0]) {
+static statusLog statusDatalog;
+
+const String &datalogStatusJSON() {
+    const logStats stats = datalog.stats();
+    if (statusDatalog.json.length() > 0 && memcmp(&stats, &statusDatalog.stats, sizeof(stats)) == 0) {
+        return statusDatalog.json;
+    }
+    statusDatalog.stats = stats;
+
+    String &out = statusDatalog.json;
+    out = "{\"firstRev\":";
+    appendFixed(out, stats.firstRev, 0);
+    out.concat(",\"firstTS\":");
+    appendFixed(out, stats.firstTS, 0);
+    out.concat(",\"lastRev\":");
+    appendFixed(out, stats.lastRev, 0);
+    out.concat(",\"lastTS\":");
+    appendFixed(out, stats.lastTS, 0);
+    out.concat(",\"interval\":");
+    appendFixed(out, datalog.interval(), 0);
+    out.concat(",\"size\":");
+    appendFixed(out, stats.fileSize, 0);
+    out.concat('}');
+    return out;
+}
+
+// handleStatus assembles /status from cached sections. Only the stats are
+// formatted on each call, the devices come from the /live frame of the
+// latest sample.
+void handleStatus(httpRequest &req, httpResponse &res) {
+    static String response;
+
+    const time_t now = time(nullptr);
+    response = "{\"version\":\"";
+    response.concat(AURAMON_VERSION);
+    response.concat("\",\"stats\":{\"startTime\":");
+    appendFixed(response, startTime, 0);
+    response.concat(",\"currentTime\":");
+    appendFixed(response, now, 0);
+    response.concat(",\"runSeconds\":");
+    appendFixed(response, now - startTime, 0);
+    response.concat(",\"heapFree\":");
+    appendFixed(response, rp2040.getFreeHeap(), 0);
+
+    response.concat("},\"devices\":");
+    liveFrame *frame = acquireLiveFrame();
+    if (frame) {
+        response.concat(frame->data + frame->devicesStart, frame->devicesLen);
+        releaseLiveFrame(frame);
+    } else {
+        response.concat("[]");
+    }
+
+    response.concat(",\"datalog\":");
+    response.concat(datalogStatusJSON());
+    response.concat(",\"network\":");
+    response.concat(networkStatusJSON());
+    response.concat('}');
+
+    res.send(200, contentTypeJSON, response);
+}
+
+// A binary row is made in the writer's buffer, so it must fit in a chunk.
+static_assert(energyRowSize(MAX_DEVICES) <= responseChunkSize, "MAX_DEVICES too large for a binary energy row");
+
+// Devices of a CSV row written a call. Every value takes at most
+// formatFixedSize bytes with its comma, and the timestamp and Hz that start
+// the row fit in two more, so a call never makes more than one chunk.
+constexpr size_t energyCSVDevices = (responseChunkSize - 2 * formatFixedSize) / (energyDeviceColumns * formatFixedSize);
+static_assert(energyCSVDevices > 0, "a CSV energy device does not fit in a chunk");
+
+// Longest device name written in a column header.
+constexpr size_t energyNameMax = 255;
+
+// energyStream is the state of an /energy response between polls.
+struct energyStream {
+    deviceColumn  columns[MAX_DEVICES];
+    uint8_t       chans[MAX_DEVICES];
+    size_t        count;
+    size_t        rowSize;
+    logRecord     prevRec;
+    uint32_t      ts;
+    uint32_t      end;
+    uint32_t      interval;
+    uint32_t      revStep;
+    unsigned long began;
+    bool          binary;
+    size_t        headerDone; // Columns whose header has been written.
+    bool          started;    // The file header has been written.
+    // A CSV row being written, over as many calls as its devices need.
+    double        values[1 + energyDeviceColumns * MAX_DEVICES];
+    uint32_t      rowTS;
+    size_t        rowNext; // Next device of the row to write.
+    bool          rowPending;
+};
+
+// writeEnergyColumn writes the header of one device column.
+void writeEnergyColumn(energyStream *s, responseWriter &out, const deviceColumn &col) {
+    // Bounded, so a column header never makes more than one chunk.
+    const size_t len = std::min<size_t>(col.name.length(), energyNameMax);
+    const char * name = col.name.c_str();
+    if (s->binary) {
+        out.write(static_cast<char>(col.index));
+        out.write(static_cast<char>(len));
+        out.write(name, len);
+        return;
+    }
+
+    out.write(',');
+    out.write(name, len);
+    out.write(".V,");
+    out.write(name, len);
+    out.write(".A,");
+    out.write(name, len);
+    out.write(".W,");
+    out.write(name, len);
+    out.write(".Wh,");
+    out.write(name, len);
+    out.write(".PF");
+}
+
+// writeEnergyCSV writes the next energyCSVDevices devices of the pending row.
+void writeEnergyCSV(energyStream *s, responseWriter &out) {
+    if (s->rowNext == 0) {
+        out.writeUint(s->rowTS);
+        out.write(',');
+        out.writeFixed(s->values[0], 2);
+    }
+    const size_t last = std::min(s->count, s->rowNext + energyCSVDevices);
+    for (; s->rowNext < last; s->rowNext++) {
+        const double *v = &s->values[1 + s->rowNext * energyDeviceColumns];
+        out.write(',');
+        out.writeFixed(v[0], 3);
+        out.write(',');
+        out.writeFixed(v[1], 3);
+        out.write(',');
+        out.writeFixed(v[2], 3);
+        out.write(',');
+        out.writeFixed(v[3], 6);
+        out.write(',');
+        out.writeFixed(v[4], 4);
+    }
+    if (s->rowNext == s->count) {
+        out.write('\n');
+        s->rowPending = false;
+    }
+}
+
+// produceEnergy writes the header piece by piece, then one row a call. A
+// CSV row of many devices is spread over several calls.
+bool produceEnergy(void *ctx, responseWriter &out) {
+    auto   s = static_cast<energyStream *>(ctx);
+    size_t free;
+
+    if (!s->started) {
+        s->started = true;
+        if (s->binary) {
+            const energyHeader hdr{energyMagic, energyVersion, static_cast<uint16_t>(s->count), s->interval,
+                                   static_cast<uint32_t>(s->rowSize)};
+            out.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+        } else {
+            out.write("timestamp,Hz");
+        }
+        return true;
+    }
+    if (s->headerDone < s->count) {
+        writeEnergyColumn(s, out, s->columns[s->headerDone++]);
+        if (s->headerDone == s->count && !s->binary) {
+            out.write('\n');
+        }
+        return true;
+    }
+    if (s->rowPending) {
+        writeEnergyCSV(s, out);
+        return true;
+    }
+
+    for (uint8_t reads = 0; s->ts <= s->end; reads++) {
+        if (reads == ENERGY_READS_PER_CALL) {
+            // Still in a gap. Let the other connections and tasks run, then carry on.
+            return true;
+        }
+        if (millis() - s->began > ENERGY_BUDGET_MS) {
+            // Hand back a cursor so the client can carry on from here.
+            if (s->binary) {
+                char *p = out.buffer(s->rowSize, &free);
+                out.commit(packEnergyMarker(energyCursorTS, s->ts, s->prevRec.rev + s->revStep, s->count,
+                                            reinterpret_cast<uint8_t *>(p)));
+                return false;
+            }
+            out.write("#next start=");
+            out.writeUint(s->ts);
+            out.write(" rev=");
+            out.writeUint(s->prevRec.rev + s->revStep);
+            out.write('\n');
+            return false;
+        }
+
+        const uint32_t ts = s->ts;
+        s->ts += s->interval;
+
+        logRecord rec;
+        if (auto err = datalog.readFrom(ts, s->prevRec.rev + s->revStep, &rec); err) {
+            if (s->binary) {
+                char *p = out.buffer(s->rowSize, &free);
+                out.commit(packEnergyMarker(energyErrorTS, 0, 0, s->count, reinterpret_cast<uint8_t *>(p)));
+            } else {
+                out.write("#error reading datalog\n");
+            }
+            return false;
+        }
+
+        if (rec.rev == s->prevRec.rev) {
             continue;
         }
 
-        auto deviceObj = devicesArr.add<JsonObject>();
-        deviceObj["name"] = String(data->name);
-        deviceObj["volts"] = data->volts;
-        deviceObj["amps"] = data->amps;
-        deviceObj["pf"] = data->pf;
-        deviceObj["hz"] = data->hz;
-    }
-    mutex_exit(&deviceDataMu);
-
-    JsonObject datalogObj = doc["datalog"].to<JsonObject>();
-    datalogObj["firstRev"] = datalog.firstRev();
-    datalogObj["firstTS"] = datalog.firstTS();
-    datalogObj["lastRev"] = datalog.lastRev();
-    datalogObj["lastTS"] = datalog.lastTS();
-    datalogObj["interval"] = datalog.interval();
-    datalogObj["size"] = datalog.fileSize();
-
-    JsonObject networkObj = doc["network"].to<JsonObject>();
-    networkObj["hostname"] = netCfg.hostname;
-    networkObj["ip"] = eth.localIP().toString();
-    networkObj["gateway"] = eth.gatewayIP().toString();
-    networkObj["subnet"] = eth.subnetMask().toString();
-    networkObj["dns"] = eth.dnsIP().toString();
-    char mac_str[18];
-    sprintf_P(mac_str, PSTR("%02X:%02X:%02X:%02X:%02X:%02X"), mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    networkObj["mac"] = mac_str;
+        if (!energyRow(s->prevRec, rec, s->chans, s->count, s->values)) {
+            s->prevRec = rec;
+            continue;
+        }
+        s->prevRec = rec;
 
-    String response;
-    serializeJson(doc, response);
+        if (s->binary) {
+            char *p = out.buffer(s->rowSize, &free);
+            out.commit(packEnergyRow(ts, s->values, s->count, reinterpret_cast<uint8_t *>(p)));
+            return true;
+        }
+
+        s->rowTS = ts;
+        s->rowNext = 0;
+        s->rowPending = true;
+        writeEnergyCSV(s, out);
+        return true;
+    }
 
-    server.send(200, contentTypeJSON, response);
+    LOGD("energy: completed response");
+    return false;
+}
+
+void releaseEnergy(void *ctx) {
+    delete static_cast<energyStream *>(ctx);
 }
 
-void handleEnergy() {
+void handleLive(httpRequest &req, httpResponse &res) {
+    liveClient *client = openLiveClient();
+    if (!client) {
+        res.send(503, contentTypeJSON, F("{\"error\":\"Too many live clients\"}"));
+        return;
+    }
+
+    res.header("Cache-Control", "no-cache");
+    res.stream(200, "text/event-stream", produceLive, client, releaseLive);
+}
+
+void handleEnergy(httpRequest &req, httpResponse &res) {
     uint32_t baseInterval = datalog.interval();
-    uint32_t start = server.arg("start").toInt();
-    uint32_t end = server.hasArg("end") ? server.arg("end").toInt() : time(nullptr);
-    uint32_t interval = server.hasArg("interval") ? server.arg("interval").toInt() : 5;
+    uint32_t start = argUint(req, "start", 0);
+    uint32_t end = argUint(req, "end", time(nullptr));
+    uint32_t interval = argUint(req, "interval", 5);
+    // rev comes from a previous response's cursor and saves searching for start.
+    uint32_t rev = argUint(req, "rev", 0);
 
-    LOGD("Energy request start=%u end=%u interval=%u", start, end, interval);
+    LOGD("Energy request start=%u end=%u interval=%u rev=%u", start, end, interval, rev);
 
     start -= start % baseInterval;
     end -= end % baseInterval;
     interval -= interval % baseInterval;
 
     if (start >= end || interval == 0) {
-        server.send(400, contentTypeJSON, F("{\"error\":\"Invalid parameters\"}"));
+        res.send(400, contentTypeJSON, F("{\"error\":\"Invalid parameters\"}"));
         return;
     }
-    if (end > start + interval * 100) {
-        // Limit to 100 rows to prevent excessively large responses.
-        end = start + interval * 100;
-    }
-
     if (!datalog.entries()) {
-        server.send(204, contentTypePlain, "");
+        res.send(204, contentTypePlain, "");
         return;
     }
 
     LOGD("energy: adjusted parameters start=%u end=%u interval=%u", start, end, interval);
 
-    deviceColumn deviceColumns[MAX_DEVICES];
-    size_t       deviceCount = 0;
+    auto s = new energyStream{};
     mutex_enter_blocking(&deviceInfoMu);
     for (uint8_t i = 0; i < MAX_DEVICES; i++) {
         auto info = deviceInfos[i];
         if (!info || !info->isEnabled() || !info->name || !info->name[0]) {
             continue;
         }
-        deviceColumns[deviceCount++] = deviceColumn{i, String(info->name)};
+        s->columns[s->count++] = deviceColumn{info->channel, String(info->name)};
     }
     mutex_exit(&deviceInfoMu);
 
-    LOGD("energy: collected devices: %u", deviceCount);
+    LOGD("energy: collected devices: %u", s->count);
 
-    if (deviceCount == 0) {
-        server.send(204, contentTypePlain, "");
+    if (s->count == 0) {
+        delete s;
+        res.send(204, contentTypePlain, "");
         return;
     }
 
     uint32_t lastTs = datalog.lastTS();
     if (start > lastTs) {
-        server.send(204, contentTypePlain, "");
+        delete s;
+        res.send(204, contentTypePlain, "");
         return;
     }
     if (end > lastTs) {
         end = lastTs;
     }
 
-    logRecord prevRec;
-    if (auto err = datalog.read(start - interval, &prevRec); err) {
-        returnInternalError(err->Error());
-        return;
-    }
-
-    LOGD("energy: read previous record: %u", prevRec.rev);
+    // Without gaps in the log, each row is a fixed number of revs on.
+    s->revStep = interval / baseInterval;
 
-    if (!server.chunkedResponseModeStart(200, contentTypePlain)) {
-        server.send(505, contentTypeHTML, F("HTTP1.1 required"));
+    if (auto err = datalog.readFrom(start - interval, rev - s->revStep, &s->prevRec); err) {
+        delete s;
+        returnInternalError(res, err->Error());
         return;
     }
 
-    String header = F("timestamp,Hz");
-    for (size_t i = 0; i < deviceCount; i++) {
-        const String &name = deviceColumns[i].name;
-        header += "," + name + ".V";
-        header += "," + name + ".A";
-        header += "," + name + ".W";
-        header += "," + name + ".Wh";
-        header += "," + name + ".PF";
-    }
-    header += "\n";
-    server.sendContent(header);
-
-    for (uint32_t ts = start; ts <= end; ts += interval) {
-        logRecord rec;
-        if (auto err = datalog.read(ts, &rec); err) {
-            server.sendContent(F("#error reading datalog\n"));
-            server.chunkedResponseFinalize();
-            return;
-        }
-
-        if (rec.rev == prevRec.rev) {
-            continue;
-        }
+    LOGD("energy: read previous record: %u", s->prevRec.rev);
 
-        const double elapsedHours = rec.logHours - prevRec.logHours;
-        if (elapsedHours <= 0) {
-            prevRec = rec;
-            continue;
-        }
-
-        auto row = String(ts);
-        row.reserve(row.length() + deviceCount * 48);
-
-        const double hz = (rec.hzHrs - prevRec.hzHrs) / elapsedHours;
-        appendCSVValue(row, hz, 2);
+    for (size_t i = 0; i < s->count; i++) {
+        s->chans[i] = s->columns[i].index;
+    }
 
-        for (size_t i = 0; i < deviceCount; i++) {
-            const uint8_t idx = deviceColumns[i].index;
-            const double  voltage = (rec.voltHrs[idx] - prevRec.voltHrs[idx]) / elapsedHours;
-            double        energyWh = rec.wattHrs[idx] - prevRec.wattHrs[idx];
-            const double  power = energyWh / elapsedHours;
-            const double  apparentPower = (rec.vaHrs[idx] - prevRec.vaHrs[idx]) / elapsedHours;
-            if (energyWh < 0) {
-                energyWh = 0;
-            }
-            const double current = (voltage != 0.0) ? (apparentPower / voltage) : 0.0;
-            const double powerFactor = (apparentPower > 0.0) ? (power / apparentPower) : 0.0;
+    // Binary rows are asked for with format=bin or by accepting the energy content type.
+    const char *format = req.arg("format");
+    const char *accept = req.header("Accept");
+    s->binary = (format && strcmp(format, "bin") == 0) || (accept && strstr(accept, contentTypeEnergy));
+    s->rowSize = energyRowSize(s->count);
+    s->ts = start;
+    s->end = end;
+    s->interval = interval;
+    s->began = millis();
+
+    res.stream(200, s->binary ? contentTypeEnergy : contentTypePlain, produceEnergy, s, releaseEnergy);
+}
 
-            appendCSVValue(row, voltage);
-            appendCSVValue(row, current);
-            appendCSVValue(row, power);
-            appendCSVValue(row, energyWh, 6);
-            appendCSVValue(row, powerFactor, 4);
-        }
+// fileStream sends a file from the SD card. sdMu is only taken around each
+// read so a slow client never holds up the logger.
+struct fileStream {
+    FsFile file;
+    size_t remaining;
+};
 
-        row += "\n";
-        server.sendContent(row);
-        prevRec = rec;
+bool produceFile(void *ctx, responseWriter &out) {
+    auto s = static_cast<fileStream *>(ctx);
+    if (s->remaining == 0) {
+        return false;
+    }
+    if (!mutex_try_enter(&sdMu, nullptr)) {
+        // Busy, try again on the next poll.
+        return true;
     }
 
-    LOGD("energy: completed response");
+    size_t    free;
+    char *    p = out.buffer(1, &free);
+    const int n = s->file.read(p, std::min(s->remaining, free));
+    mutex_exit(&sdMu);
+    if (n <= 0) {
+        return false;
+    }
+    out.commit(n);
+    s->remaining -= n;
+    return true;
+}
 
-    server.chunkedResponseFinalize();
+void releaseFile(void *ctx) {
+    auto s = static_cast<fileStream *>(ctx);
+    mutex_enter_blocking(&sdMu);
+    s->file.close();
+    mutex_exit(&sdMu);
+    delete s;
 }
 
-void handleLogs() {
+void handleLogs(httpRequest &req, httpResponse &res) {
     uint32_t startOffset = 0;
-    if (server.hasArg("start")) {
-        startOffset = server.arg("start").toInt();
-        if (startOffset == 0 && server.arg("start") != "0") {
-            server.send(400, contentTypeJSON, F("{\"error\":\"Invalid start\"}"));
+    if (const char *v = req.arg("start"); v) {
+        char *end;
+        startOffset = strtoul(v, &end, 10);
+        if (end == v || *end) {
+            res.send(400, contentTypeJSON, F("{\"error\":\"Invalid start\"}"));
             return;
         }
     }
     uint32_t limitBytes = 0;
-    if (server.hasArg("limit")) {
-        limitBytes = server.arg("limitBytes").toInt();
+    if (req.hasArg("limit")) {
+        limitBytes = argUint(req, "limit", 0);
         if (limitBytes == 0) {
-            server.send(400, contentTypeJSON, F("{\"error\":\"Invalid limit\"}"));
+            res.send(400, contentTypeJSON, F("{\"error\":\"Invalid limit\"}"));
             return;
         }
     }
 
     if (!mutex_enter_block_until(&sdMu, 100)) {
-        server.send(408, contentTypePlain, "Request Timeout");
+        res.send(408, contentTypePlain, "Request Timeout");
         return;
     }
 
-    if (!sd.exists(MESSAGE_LOG_PATH)) {
+    auto s = new fileStream{};
+    if (!s->file.open(&sd, MESSAGE_LOG_PATH, O_READ)) {
         mutex_exit(&sdMu);
-        server.send(404, contentTypeJSON, F("{\"error\":\"Not Found\"}"));
+        delete s;
+        res.send(404, contentTypeJSON, F("{\"error\":\"Not Found\"}"));
+        return;
     }
 
-    if (auto f = sd.open(MESSAGE_LOG_PATH, O_READ); f) {
-        const size_t fileSize = f.size();
-        if (startOffset >= fileSize) {
-            server.send(204, contentTypePlain, "");
-            f.close();
-            mutex_exit(&sdMu);
-            return;
-        }
-        if (startOffset > 0 && !f.seek(startOffset)) {
-            returnInternalError("could not seek log");
-            f.close();
-            mutex_exit(&sdMu);
-            return;
-        }
-
-        size_t remaining = fileSize - startOffset;
-        if (limitBytes > 0 && limitBytes < remaining) {
-            remaining = limitBytes;
-        }
-        if (remaining == 0) {
-            server.send(204, contentTypePlain, "");
-            f.close();
-            mutex_exit(&sdMu);
-            return;
-        }
-
-        if (!server.chunkedResponseModeStart(200, contentTypePlain)) {
-            server.send(505, contentTypePlain, F("HTTP1.1 required"));
-            f.close();
-            mutex_exit(&sdMu);
-            return;
-        }
-
-        uint8_t buffer[1024];
-        while (remaining > 0) {
-            const size_t readLen = f.read(buffer, min(remaining, sizeof(buffer)));
-            if (readLen == 0) {
-                break;
-            }
-            server.sendContent(reinterpret_cast<char *>(buffer), readLen);
-            remaining -= readLen;
-        }
-        server.chunkedResponseFinalize();
-        f.close();
-
+    const size_t fileSize = s->file.size();
+    if (startOffset >= fileSize) {
+        s->file.close();
+        mutex_exit(&sdMu);
+        delete s;
+        res.send(204, contentTypePlain, "");
+        return;
+    }
+    if (startOffset > 0 && !s->file.seek(startOffset)) {
+        s->file.close();
         mutex_exit(&sdMu);
+        delete s;
+        returnInternalError(res, "could not seek log");
         return;
     }
     mutex_exit(&sdMu);
 
-    server.send(404, contentTypeJSON, "Not Found");
+    s->remaining = fileSize - startOffset;
+    if (limitBytes > 0 && limitBytes < s->remaining) {
+        s->remaining = limitBytes;
+    }
+
+    res.stream(200, contentTypePlain, produceFile, s, releaseFile);
 }
 
 static bool    otaRestartNeeded = false;
 static bool    otaUploadFailed = false;
 static uint8_t otaErrorCode = UPDATE_ERROR_OK;
+// Connections upload at the same time, but there is one flash updater.
+static const httpRequest *otaOwner = nullptr;
+
+void handleOtaFinish(httpRequest &req, httpResponse &res) {
+    if (otaOwner != &req) {
+        res.send(409, contentTypeJSON, F("{\"error\":\"Update in progress\"}"));
+        return;
+    }
+    otaOwner = nullptr;
 
-void handleOtaFinish() {
     if (otaUploadFailed || Update.hasError()) {
         String msg = F("{\"error\":\"Update failed\",\"code\":");
         msg.concat(otaErrorCode);
         msg.concat("}");
-        server.send(500, contentTypeJSON, msg);
+        res.send(500, contentTypeJSON, msg);
 
         if (otaRestartNeeded) {
             LOGE("OTA: update failed with code %u. Rebooting", otaErrorCode);
-
-            mutex_enter_blocking(&sdMu);
-            delay(100);
-            rp2040.reboot();
+            requestReboot();
+            return;
         }
 
         LOGE("OTA: update failed with code %u", otaErrorCode);
@@ -517,24 +1056,25 @@ void handleOtaFinish() {
 
     LOGI("OTA: update finished, rebooting");
 
-    server.send(204, contentTypePlain, "");
-    mutex_enter_blocking(&sdMu);
-    delay(100);
-    rp2040.reboot();
+    res.send(204, contentTypePlain, "");
+    requestReboot();
 }
 
-void handleOtaUpload() {
-    HTTPUpload &upload = server.upload();
-
-    if (upload.status == UPLOAD_FILE_START) {
+void handleOtaUpload(httpRequest &req, httpUpload &upload) {
+    if (upload.status == httpUploadStatus::Start) {
+        if (otaOwner && otaOwner != &req) {
+            LOGE("OTA: upload already in progress");
+            return;
+        }
+        otaOwner = &req;
         otaUploadFailed = false;
         otaErrorCode = UPDATE_ERROR_OK;
         Update.clearError();
 
-        if (upload.name != "firmware") {
+        if (strcmp(upload.name, "firmware") != 0) {
             otaUploadFailed = true;
             otaErrorCode = UPDATE_ERROR_NO_DATA;
-            LOGE("OTA: unexpected form field name: %s", upload.name.c_str());
+            LOGE("OTA: unexpected form field name: %s", upload.name);
             return;
         }
 
@@ -553,8 +1093,14 @@ void handleOtaUpload() {
         }
 
         LOGD("OTA: update started");
-    } else if (upload.status == UPLOAD_FILE_WRITE && !otaUploadFailed) {
-        if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
+        return;
+    }
+    if (otaOwner != &req) {
+        return;
+    }
+
+    if (upload.status == httpUploadStatus::Write && !otaUploadFailed) {
+        if (Update.write(const_cast<uint8_t *>(upload.buf), upload.currentSize) != upload.currentSize) {
             otaUploadFailed = true;
             otaErrorCode = Update.getError();
             LOGE("OTA: write failed (%u)", otaErrorCode);
@@ -562,7 +1108,7 @@ void handleOtaUpload() {
         }
 
         LOGD("OTA: written %u bytes", upload.totalSize);
-    } else if (upload.status == UPLOAD_FILE_END && !otaUploadFailed) {
+    } else if (upload.status == httpUploadStatus::End && !otaUploadFailed) {
         if (!Update.end(true)) {
             otaUploadFailed = true;
             otaErrorCode = Update.getError();
@@ -571,194 +1117,264 @@ void handleOtaUpload() {
         }
 
         LOGI("OTA: upload complete (%u bytes)", upload.totalSize);
-    } else if (upload.status == UPLOAD_FILE_ABORTED) {
+    } else if (upload.status == httpUploadStatus::Aborted) {
         otaUploadFailed = true;
         otaErrorCode = UPDATE_ERROR_STREAM;
+        otaOwner = nullptr;
         Update.end();
 
         LOGE("OTA: upload aborted\r");
     }
 }
 
-static bool   publicUploadFailed = false;
-static int    publicUploadStatus = 200;
-static String publicUploadError;
-static bool   publicUploadMutexHeld = false;
-static FsFile publicUploadFile;
+static bool              publicUploadFailed = false;
+static int               publicUploadStatus = 200;
+static String            publicUploadError;
+static FsFile            publicUploadFile;
+static String            publicUploadPath;
+static uint64_t          publicUploadHash = assetHashSeed;
+static const httpRequest *publicUploadOwner = nullptr;
+
+// failPublicUpload records why the upload failed and closes the file.
+void failPublicUpload(int status, const __FlashStringHelper *reason) {
+    publicUploadFailed = true;
+    publicUploadStatus = status;
+    publicUploadError = reason;
+    if (publicUploadFile) {
+        mutex_enter_blocking(&sdMu);
+        publicUploadFile.close();
+        mutex_exit(&sdMu);
+    }
+}
+
+void handlePublicUploadFinish(httpRequest &req, httpResponse &res) {
+    if (publicUploadOwner != &req) {
+        res.send(409, contentTypeJSON, F("{\"error\":\"Upload in progress\"}"));
+        return;
+    }
+    publicUploadOwner = nullptr;
 
-void handlePublicUploadFinish() {
     if (publicUploadFailed) {
         String msg = F("{\"error\":\"Upload failed\",\"reason\":\"");
         msg.concat(publicUploadError);
         msg.concat("\"}");
-        server.send(publicUploadStatus, contentTypeJSON, msg);
+        res.send(publicUploadStatus, contentTypeJSON, msg);
         return;
     }
 
-    server.send(204, contentTypePlain, "");
+    res.send(204, contentTypePlain, "");
 }
 
-void handlePublicUpload() {
-    HTTPUpload &upload = server.upload();
-
-    if (upload.status == UPLOAD_FILE_START) {
+// handlePublicUpload takes sdMu for each write, not for the whole upload,
+// so the logger keeps writing while a slow client sends a file.
+void handlePublicUpload(httpRequest &req, httpUpload &upload) {
+    if (upload.status == httpUploadStatus::Start) {
+        if (publicUploadOwner && publicUploadOwner != &req) {
+            LOGE("Public upload: upload already in progress");
+            return;
+        }
+        publicUploadOwner = &req;
         publicUploadFailed = false;
         publicUploadStatus = 200;
         publicUploadError = "";
 
-        if (upload.name != "file") {
-            publicUploadFailed = true;
-            publicUploadStatus = 400;
-            publicUploadError = F("Unexpected form field name");
-            LOGE("Public upload: unexpected form field name: %s", upload.name.c_str());
+        if (strcmp(upload.name, "file") != 0) {
+            failPublicUpload(400, F("Unexpected form field name"));
+            LOGE("Public upload: unexpected form field name: %s", upload.name);
             return;
         }
 
-        if (upload.filename.length() == 0 || upload.filename.indexOf('/') >= 0 ||
-            upload.filename.indexOf('\\') >= 0) {
-            publicUploadFailed = true;
-            publicUploadStatus = 400;
-            publicUploadError = F("Invalid filename");
-            LOGE("Public upload: invalid filename: %s", upload.filename.c_str());
+        if (upload.filename[0] == '\0' || strchr(upload.filename, '/') || strchr(upload.filename, '\\')) {
+            failPublicUpload(400, F("Invalid filename"));
+            LOGE("Public upload: invalid filename: %s", upload.filename);
             return;
         }
 
         String path = "public/";
         path.concat(upload.filename);
+        publicUploadPath = path;
+        publicUploadHash = assetHashSeed;
+        // The file is about to change, tags served so far no longer hold.
+        forgetAssets();
 
         LOGI("Public upload: start %s", path.c_str());
 
         if (!mutex_enter_block_until(&sdMu, 100)) {
-            publicUploadFailed = true;
-            publicUploadStatus = 408;
-            publicUploadError = F("Request Timeout");
+            failPublicUpload(408, F("Request Timeout"));
             LOGE("Public upload: failed to acquire sdMu");
             return;
         }
-        publicUploadMutexHeld = true;
-
-        publicUploadFile = sd.open(path.c_str(), O_WRITE | O_CREAT | O_TRUNC);
-        if (!publicUploadFile) {
-            publicUploadFailed = true;
-            publicUploadStatus = 500;
-            publicUploadError = F("Failed to open file");
-            mutex_exit(&sdMu);
+        // Until the new tag is written the file has none, so a client cannot
+        // keep a half written file under the old one.
+        sd.remove((path + assetTagSuffix).c_str());
+        const bool opened = publicUploadFile.open(&sd, path.c_str(), O_WRITE | O_CREAT | O_TRUNC);
+        mutex_exit(&sdMu);
+        if (!opened) {
+            failPublicUpload(500, F("Failed to open file"));
             LOGE("Public upload: failed to open %s", path.c_str());
-            publicUploadMutexHeld = false;
-        }
-    } else if (upload.status == UPLOAD_FILE_WRITE && !publicUploadFailed) {
-        if (publicUploadFile.write(upload.buf, upload.currentSize) != upload.currentSize) {
-            publicUploadFailed = true;
-            publicUploadStatus = 500;
-            publicUploadError = F("Write failed");
-            Serial.printf("Public upload: write failed at %u bytes", upload.totalSize);
-            publicUploadFile.close();
-            if (publicUploadMutexHeld) {
-                mutex_exit(&sdMu);
-                publicUploadMutexHeld = false;
-            }
         }
-    } else if (upload.status == UPLOAD_FILE_END && !publicUploadFailed) {
-        publicUploadFile.flush();
-        publicUploadFile.close();
+        return;
+    }
+    if (publicUploadOwner != &req) {
+        return;
+    }
 
-        if (publicUploadMutexHeld) {
-            mutex_exit(&sdMu);
-            publicUploadMutexHeld = false;
+    if (upload.status == httpUploadStatus::Write && !publicUploadFailed) {
+        if (!mutex_enter_block_until(&sdMu, 100)) {
+            failPublicUpload(408, F("Request Timeout"));
+            LOGE("Public upload: failed to acquire sdMu");
+            return;
         }
-
-        LOGI("Public upload: complete (%u bytes)", upload.totalSize);
-    } else if (upload.status == UPLOAD_FILE_ABORTED) {
-        publicUploadFailed = true;
-        publicUploadStatus = 500;
-        publicUploadError = F("Upload aborted");
-
-        if (publicUploadFile) {
-            publicUploadFile.close();
+        const size_t written = publicUploadFile.write(upload.buf, upload.currentSize);
+        mutex_exit(&sdMu);
+        if (written != upload.currentSize) {
+            failPublicUpload(500, F("Write failed"));
+            LOGE("Public upload: write failed at %u bytes", upload.totalSize);
+            return;
         }
-
-        if (publicUploadMutexHeld) {
-            mutex_exit(&sdMu);
-            publicUploadMutexHeld = false;
+        publicUploadHash = assetHash(publicUploadHash, upload.buf, upload.currentSize);
+    } else if (upload.status == httpUploadStatus::End && !publicUploadFailed) {
+        // The tag is kept next to the file, so serving it needs no hashing.
+        char tag[assetTagSize];
+        formatAssetTag(tag, publicUploadHash);
+        const String tagPath = publicUploadPath + assetTagSuffix;
+
+        mutex_enter_blocking(&sdMu);
+        publicUploadFile.close();
+        FsFile     tagFile;
+        const bool tagged = tagFile.open(&sd, tagPath.c_str(), O_WRITE | O_CREAT | O_TRUNC) &&
+                            tagFile.write(tag, assetTagSize - 1) == assetTagSize - 1;
+        tagFile.close();
+        mutex_exit(&sdMu);
+        if (!tagged) {
+            failPublicUpload(500, F("Failed to write tag"));
+            LOGE("Public upload: failed to write %s", tagPath.c_str());
+            return;
         }
+        forgetAssets();
+
+        LOGI("Public upload: complete (%u bytes, tag %s)", upload.totalSize, tag);
+    } else if (upload.status == httpUploadStatus::Aborted) {
+        failPublicUpload(500, F("Upload aborted"));
+        publicUploadOwner = nullptr;
 
         LOGE("Public upload: aborted");
     }
 }
 
-void handleNotFound() {
-    LOGD("NotFound requested URL: %s", server.uri().c_str());
+// contentTypeFor returns the content type for a public file, ignoring a .gz suffix.
+const char *contentTypeFor(const String &path) {
+    if (path.endsWith(".html") || path.endsWith(".html.gz")) {
+        return contentTypeHTML;
+    } else if (path.endsWith(".css") || path.endsWith(".css.gz")) {
+        return "text/css";
+    } else if (path.endsWith(".js") || path.endsWith(".js.gz")) {
+        return "application/javascript";
+    } else if (path.endsWith(".json") || path.endsWith(".json.gz")) {
+        return contentTypeJSON;
+    } else if (path.endsWith(".png") || path.endsWith(".png.gz")) {
+        return "image/png";
+    } else if (path.endsWith(".jpg") || path.endsWith(".jpeg") ||
+               path.endsWith(".jpg.gz") || path.endsWith(".jpeg.gz")) {
+        return "image/jpeg";
+    } else if (path.endsWith(".ico") || path.endsWith(".ico.gz")) {
+        return "image/x-icon";
+    } else if (path.endsWith(".svg") || path.endsWith(".svg.gz")) {
+        return "image/svg+xml";
+    }
+    return contentTypePlain;
+}
 
-    if (server.method() != HTTP_GET) {
-        server.send(405, contentTypePlain, "Method Not Allowed");
+// readAssetTag reads the tag stored next to a public file, leaving tag empty
+// if there is none. sdMu must be held.
+void readAssetTag(const String &path, char *tag) {
+    tag[0] = '\0';
+    FsFile     file;
+    const auto tagPath = path + assetTagSuffix;
+    if (!file.open(&sd, tagPath.c_str(), O_READ)) {
         return;
     }
-
-    if (!mutex_enter_block_until(&sdMu, 100)) {
-        server.send(408, contentTypePlain, "Request Timeout");
+    const int n = file.read(tag, assetTagSize - 1);
+    file.close();
+    if (n != static_cast<int>(assetTagSize - 1) || tag[0] != '"' || tag[assetTagSize - 2] != '"') {
+        tag[0] = '\0';
         return;
     }
+    tag[assetTagSize - 1] = '\0';
+}
 
-    String path = server.uri();
-    if (!path.startsWith("/")) path = '/' + path;
-    if (path == "/") path = "/index.html";
-    path = "public" + path;
-    auto gzPath = path + ".gz";
+// handleNotFound serves public files. What is learned about a file the first
+// time it is served is remembered, so a client revalidating its copy gets a
+// 304 without the card being touched.
+void handleNotFound(httpRequest &req, httpResponse &res) {
+    LOGD("NotFound requested URL: %s", req.path);
 
-    if (sd.exists(gzPath.c_str())) {
-        server.sendHeader("Content-Encoding", "gzip");
-        path = gzPath;
-    } else if (!sd.exists(path.c_str())) {
-        mutex_exit(&sdMu);
-        server.send(404, contentTypeJSON, F("{\"error\":\"Not Found\"}"));
+    if (req.method != httpMethod::Get) {
+        res.send(405, contentTypePlain, "Method Not Allowed");
+        return;
     }
 
-    if (auto f = sd.open(path.c_str(), O_READ); f) {
-        if (f.isDirectory()) {
-            f.close();
-            mutex_exit(&sdMu);
-            server.send(403, contentTypePlain, "Forbidden");
-            return;
-        }
+    String key = req.path;
+    if (!key.startsWith("/")) key = '/' + key;
+    if (key == "/") key = "/index.html";
+    const String path = "public" + key;
+    const String gzPath = path + ".gz";
+
+    const assetInfo *known = findAsset(key.c_str());
+    if (known && assetTagMatches(req.header("If-None-Match"), known->tag)) {
+        res.header("ETag", known->tag);
+        res.header("Cache-Control", "no-cache");
+        res.send(304, contentTypeFor(path), "");
+        return;
+    }
 
-        String contentType = contentTypePlain;
-        if (path.endsWith(".html") || path.endsWith(".html.gz")) {
-            contentType = F("text/html");
-        } else if (path.endsWith(".css") || path.endsWith(".css.gz")) {
-            contentType = F("text/css");
-        } else if (path.endsWith(".js") || path.endsWith(".js.gz")) {
-            contentType = F("application/javascript");
-        } else if (path.endsWith(".json") || path.endsWith(".json.gz")) {
-            contentType = contentTypeJSON;
-        } else if (path.endsWith(".png") || path.endsWith(".png.gz")) {
-            contentType = F("image/png");
-        } else if (path.endsWith(".jpg") || path.endsWith(".jpeg") ||
-                   path.endsWith(".jpg.gz") || path.endsWith(".jpeg.gz")) {
-            contentType = F("image/jpeg");
-        } else if (path.endsWith(".ico") || path.endsWith(".ico.gz")) {
-            contentType = F("image/x-icon");
-        } else if (path.endsWith(".svg") || path.endsWith(".svg.gz")) {
-            contentType = F("image/svg+xml");
-        }
-
-        if (!server.chunkedResponseModeStart(200, contentType.c_str())) {
-            server.send(505, contentTypePlain, F("HTTP1.1 required"));
-            f.close();
-            mutex_exit(&sdMu);
-            return;
-        }
+    if (!mutex_enter_block_until(&sdMu, 100)) {
+        res.send(408, contentTypePlain, "Request Timeout");
+        return;
+    }
 
-        uint8_t buffer[1024];
-        while (size_t readLen = f.read(buffer, sizeof(buffer))) {
-            server.sendContent(reinterpret_cast<char *>(buffer), readLen);
-        }
-        server.chunkedResponseFinalize();
-        f.close();
+    // A file served before is opened straight away, otherwise the .gz is tried first.
+    auto s = new fileStream{};
+    bool gzip;
+    if (known && s->file.open(&sd, known->gzip ? gzPath.c_str() : path.c_str(), O_READ)) {
+        gzip = known->gzip;
+    } else if (s->file.open(&sd, gzPath.c_str(), O_READ)) {
+        gzip = true;
+    } else if (s->file.open(&sd, path.c_str(), O_READ)) {
+        gzip = false;
+    } else {
+        mutex_exit(&sdMu);
+        delete s;
+        res.send(404, contentTypeJSON, F("{\"error\":\"Not Found\"}"));
+        return;
+    }
 
+    if (s->file.isDirectory()) {
+        s->file.close();
         mutex_exit(&sdMu);
+        delete s;
+        res.send(403, contentTypePlain, "Forbidden");
         return;
     }
+    s->remaining = s->file.size();
+
+    char tag[assetTagSize];
+    if (known && known->gzip == gzip) {
+        strcpy(tag, known->tag);
+    } else {
+        readAssetTag(gzip ? gzPath : path, tag);
+        rememberAsset(key.c_str(), gzip, tag);
+    }
     mutex_exit(&sdMu);
 
-    server.send(404, contentTypeJSON, "Not Found");
+    if (gzip) {
+        res.header("Content-Encoding", "gzip");
+    }
+    if (tag[0]) {
+        // Public files keep their names when replaced, so clients revalidate
+        // on every use rather than cache for a time.
+        res.header("ETag", tag);
+        res.header("Cache-Control", "no-cache");
+    }
+    res.stream(200, contentTypeFor(path), produceFile, s, releaseFile);
 }
@@ -7,5 +7,8 @@
 
 void setupAPI();
 
+// acceptClient returns the next waiting HTTP client, nullptr if there is none.
+httpSocket *acceptClient();
+
 
 #endif //FIRMWARE_API_H
\ No newline at end of file
@@ -0,0 +1,95 @@
+//
+// Created by Nicholas Wiersma on 2026/03/14.
+//
+
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Each block is preceded by its size, padded to keep the block aligned.
+static constexpr size_t headerSize = arenaAlign;
+
+static size_t roundUp(size_t n) {
+    return (n + arenaAlign - 1) & ~(arenaAlign - 1);
+}
+
+static size_t &blockSize(void *p) {
+    return *reinterpret_cast<size_t *>(static_cast<uint8_t *>(p) - headerSize);
+}
+
+bool arena::owns(const void *p) const {
+    const auto addr = reinterpret_cast<uintptr_t>(p);
+    const auto base = reinterpret_cast<uintptr_t>(_buf);
+    return addr >= base && addr < base + _size;
+}
+
+void *arena::allocate(size_t n) {
+    const size_t rounded = roundUp(n);
+    if (rounded < n || _size - _used < headerSize || _size - _used - headerSize < rounded) {
+        _overflows++;
+        return malloc(n);
+    }
+
+    void *p = _buf + _used + headerSize;
+    blockSize(p) = rounded;
+    _last = _used;
+    _lastValid = true;
+    _used += headerSize + rounded;
+    _peak = std::max(_peak, _used);
+    _blocks++;
+    return p;
+}
+
+void arena::deallocate(void *p) {
+    if (!p) {
+        return;
+    }
+    if (!owns(p)) {
+        free(p);
+        return;
+    }
+
+    if (--_blocks == 0) {
+        _used = 0;
+        _lastValid = false;
+        return;
+    }
+    // The newest block can be taken back right away.
+    if (_lastValid && _buf + _last + headerSize == p) {
+        _used = _last;
+        _lastValid = false;
+    }
+}
+
+void *arena::reallocate(void *p, size_t n) {
+    if (!p) {
+        return allocate(n);
+    }
+    if (!owns(p)) {
+        return realloc(p, n);
+    }
+
+    const size_t old = blockSize(p);
+    const size_t rounded = roundUp(n);
+    const bool   last = _lastValid && _buf + _last + headerSize == p;
+    if (last && rounded >= n && _size - _last - headerSize >= rounded) {
+        // The newest block grows or shrinks where it is.
+        blockSize(p) = rounded;
+        _used = _last + headerSize + rounded;
+        _peak = std::max(_peak, _used);
+        return p;
+    }
+    if (n <= old) {
+        return p;
+    }
+
+    void *q = allocate(n);
+    if (!q) {
+        return nullptr;
+    }
+    memcpy(q, p, old);
+    deallocate(p);
+    return q;
+}
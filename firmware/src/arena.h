@@ -0,0 +1,49 @@
+//
+// Created by Nicholas Wiersma on 2026/03/14.
+//
+
+#ifndef FIRMWARE_ARENA_H
+#define FIRMWARE_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Every block starts on this boundary, so anything can be stored in it.
+constexpr size_t arenaAlign = alignof(std::max_align_t);
+
+// arena is a bump allocator for memory that only lives while one request is
+// handled. Blocks are cut from a fixed buffer one after the other and only
+// the last can be given back early. Once every block is given back the whole
+// buffer is free again, so no matter how long the device runs the heap is
+// not fragmented by short lived documents. When the buffer is full blocks
+// come from the heap instead.
+class arena {
+public:
+    // buf must be aligned to arenaAlign.
+    arena(void *buf, size_t size) : _buf(static_cast<uint8_t *>(buf)), _size(size) {
+    }
+
+    void *allocate(size_t n);
+    void  deallocate(void *p);
+    void *reallocate(void *p, size_t n);
+
+    // used returns the bytes of the buffer in use, peak the most ever used.
+    size_t used() const { return _used; }
+    size_t peak() const { return _peak; }
+    // overflows returns the blocks that had to come from the heap.
+    uint32_t overflows() const { return _overflows; }
+
+private:
+    uint8_t *_buf;
+    size_t   _size;
+    size_t   _used = 0;
+    size_t   _peak = 0;
+    size_t   _last = 0; // Offset of the newest block, if _lastValid.
+    bool     _lastValid = false;
+    uint32_t _blocks = 0; // Blocks in the buffer not given back.
+    uint32_t _overflows = 0;
+
+    bool owns(const void *p) const;
+};
+
+#endif // FIRMWARE_ARENA_H
@@ -0,0 +1,97 @@
+//
+// Created by Nicholas Wiersma on 2026/03/15.
+//
+
+#include "assets.h"
+
+#include <cstring>
+
+// Only touched on core 0, by the handlers serving public files.
+static assetInfo assets[assetCacheSize];
+static uint8_t   assetCount = 0;
+static uint8_t   assetNext = 0; // Entry replaced next once full.
+
+uint64_t assetHash(uint64_t hash, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void formatAssetTag(char *buf, uint64_t hash) {
+    static const char hex[] = "0123456789abcdef";
+    buf[0] = '"';
+    for (int i = 0; i < 16; i++) {
+        buf[16 - i] = hex[hash & 0xF];
+        hash >>= 4;
+    }
+    buf[17] = '"';
+    buf[18] = '\0';
+}
+
+bool assetTagMatches(const char *ifNoneMatch, const char *tag) {
+    if (!ifNoneMatch || !tag[0]) {
+        return false;
+    }
+    const size_t tagLen = strlen(tag);
+    const char * p = ifNoneMatch;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        if (*p == '*') {
+            return true;
+        }
+        // A weak tag still matches, If-None-Match compares weakly.
+        if (strncmp(p, "W/", 2) == 0) {
+            p += 2;
+        }
+        const char *end = strchr(p, ',');
+        size_t      len = end ? end - p : strlen(p);
+        while (len > 0 && (p[len - 1] == ' ' || p[len - 1] == '\t')) {
+            len--;
+        }
+        if (len == tagLen && strncmp(p, tag, len) == 0) {
+            return true;
+        }
+        if (!end) {
+            break;
+        }
+        p = end;
+    }
+    return false;
+}
+
+const assetInfo *findAsset(const char *path) {
+    for (uint8_t i = 0; i < assetCount; i++) {
+        if (strcmp(assets[i].path, path) == 0) {
+            return &assets[i];
+        }
+    }
+    return nullptr;
+}
+
+void rememberAsset(const char *path, bool gzip, const char *tag) {
+    if (strlen(path) >= assetPathSize || strlen(tag) >= assetTagSize) {
+        return;
+    }
+
+    auto a = const_cast<assetInfo *>(findAsset(path));
+    if (!a) {
+        if (assetCount < assetCacheSize) {
+            a = &assets[assetCount++];
+        } else {
+            a = &assets[assetNext];
+            assetNext = (assetNext + 1) % assetCacheSize;
+        }
+    }
+    strcpy(a->path, path);
+    a->gzip = gzip;
+    strcpy(a->tag, tag);
+}
+
+void forgetAssets() {
+    assetCount = 0;
+    assetNext = 0;
+}
@@ -0,0 +1,48 @@
+//
+// Created by Nicholas Wiersma on 2026/03/15.
+//
+
+#ifndef FIRMWARE_ASSETS_H
+#define FIRMWARE_ASSETS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Public files remembered at once, enough for the whole web app.
+constexpr uint8_t assetCacheSize = 16;
+constexpr size_t  assetPathSize = 64;
+// An entity tag is 16 hex digits in quotes.
+constexpr size_t assetTagSize = 19;
+// Suffix of the file holding the tag of a public file.
+constexpr char assetTagSuffix[] = ".etag";
+
+// assetHash folds data into a 64 bit FNV-1a hash. Start from assetHashSeed
+// and feed the file as it is written.
+constexpr uint64_t assetHashSeed = 0xcbf29ce484222325ULL;
+uint64_t           assetHash(uint64_t hash, const uint8_t *data, size_t len);
+
+// formatAssetTag writes hash as a quoted entity tag to buf, which must hold
+// assetTagSize bytes.
+void formatAssetTag(char *buf, uint64_t hash);
+
+// assetTagMatches reports whether an If-None-Match header names tag.
+bool assetTagMatches(const char *ifNoneMatch, const char *tag);
+
+// assetInfo is what is known about a public file once it has been served,
+// so later requests need not look on the card.
+struct assetInfo {
+    char path[assetPathSize]; // Request path.
+    bool gzip;                // Served from the .gz file.
+    char tag[assetTagSize];   // Empty when the file has no tag.
+};
+
+// findAsset returns the remembered file for a request path, nullptr if it
+// has not been served yet.
+const assetInfo *findAsset(const char *path);
+// rememberAsset stores a served file, replacing the oldest when full.
+// Paths too long to keep are not remembered.
+void rememberAsset(const char *path, bool gzip, const char *tag);
+// forgetAssets drops everything remembered, for when public files change.
+void forgetAssets();
+
+#endif // FIRMWARE_ASSETS_H
@@ -10,21 +10,37 @@
 #include <errors.h>
 #include <SdFat.h>
 #include <W5500lwIP.h>
-#include <ModbusRTUMaster.h>
 #include <Wire.h>
 #include <PCF85063A.h>
-#include <WebServer.h>
 #include <ArduinoJSON.h>
 #include <Ticker.h>
 
+// Number of meter channels. Raising it with a build flag changes the
+// datalog record schema, the old log is moved aside on the next boot.
+#ifndef MAX_DEVICES
+#define MAX_DEVICES 15
+#endif
+
 #include "logger.h"
 #include "config.h"
 #include "ethernet.h"
 #include "datalog.h"
+#include "energy.h"
+#include "format.h"
+#include "response.h"
+#include "http.h"
+#include "live.h"
+#include "arena.h"
+#include "assets.h"
+#include "queue.h"
+#include "snapshot.h"
 #include "task.h"
+#include "bus.h"
+#include "meter.h"
 #include "modbus.h"
 #include "api.h"
 #include "device.h"
+#include "scan.h"
 #include "metrics.h"
 #include "version.h"
 
@@ -35,6 +51,8 @@
 #define MESSAGE_LOG_PATH "aura-mon/log.txt"
 #define CONFIG_LOG_PATH "aura-mon/config.json"
 #define DATA_LOG_PATH    "aura-mon/data.log"
+#define DATA_LOG_OLD_PATH "aura-mon/data.old"
+#define DATA_LOG_NEW_PATH "aura-mon/data.new"
 
 #define LED_RED 10
 #define LED_GREEN 11
@@ -54,8 +72,43 @@
 #define RS485_DE 2
 #define RS485_BAUDRATE 38400
 
+// A second bus runs on a PIO UART when MODBUS_BUSES is 2.
+#ifndef MODBUS_BUSES
+#define MODBUS_BUSES 1
+#endif
+#define RS485_2_TX 12
+#define RS485_2_RX 13
+#define RS485_2_DE 14
+
+// Bus speed negotiation and fallback.
+#define MODBUS_PROBE_ROUNDS 10
+#define MODBUS_MAX_ERROR_PCT 2
+#define MODBUS_FALLBACK_PASSES 5
+
+// Bus scan probe timeouts and the time given to each slice of a scan.
+#define MODBUS_SCAN_MIN_TIMEOUT_MS 4
+#define MODBUS_SCAN_MAX_TIMEOUT_MS 30
+#define MODBUS_SCAN_SLICE_MS 20
+
+#define COLLECT_INTERVAL_MS 1000
+// Longest a core sleeps between checks, well inside the 800ms watchdog.
+#define IDLE_MAX_MS 100
+// Finished log records waiting for core 0 to write them. Must be a power of two.
+#define LOG_QUEUE_SIZE 8
+// Upper bound of a believable meter energy counter delta.
+#define METER_MAX_WATTS 25000.0
+
 #define BUTTON_DEBOUNCE_MS 200
 
+// Longest a single /energy response streams before handing back a cursor.
+#define ENERGY_BUDGET_MS 10000
+// Datalog reads a single /energy producer call may make. Inside a gap in the
+// log reads find no new row, this hands core 0 back between them.
+#define ENERGY_READS_PER_CALL 4
+
+// Commands that may wait in each direction between the cores. Must be a power of two.
+#define COMMAND_QUEUE_SIZE 8
+
 enum LEDColor { Red, Orange, Green };
 
 inline byte mac[] = {0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xEE};
@@ -73,22 +126,31 @@ extern bool      rtcRunning;
 extern mutex_t sdMu;
 extern SdFs    sd;
 
-extern ModbusRTUMaster modbus;
+extern modbusBus buses[MODBUS_BUSES];
 
-extern WebServer server;
+extern httpServer server;
+
+extern taskQueue c0Queue;
+extern taskQueue c1Queue;
 
-#define MAX_DEVICES 15
-extern mutex_t             deviceDataMu;
-extern inputDeviceData *   deviceData[MAX_DEVICES];
-extern mutex_t             deviceActionMu;
-extern deviceActionRequest deviceActionControl;
-extern deviceActionRequest deviceActionData;
 extern mutex_t             deviceInfoMu;
-extern volatile bool       devicesChanged;
 extern inputDeviceInfo *   deviceInfos[MAX_DEVICES];
 extern inputDevice *       devices[MAX_DEVICES];
+// The enabled devices, in channel order. Only used on core 1.
+extern inputDevice *       activeDevices[MAX_DEVICES];
+extern uint8_t             activeDeviceCount;
+extern channelState        channels;
+extern mutex_t             scanMu;
+extern busScan             scanResult;
+// The latest readings, published by core 1 and read by core 0 without locking.
+extern snapshot<liveData>  live;
 
 extern dataLog datalog;
+// Core 1 pushes finished records, core 0 writes them to the SD card.
+extern spscQueue<logRecord, LOG_QUEUE_SIZE> logQueue;
+// Commands sent from core 0 to core 1, and from core 1 to core 0.
+extern spscQueue<deviceActionRequest, COMMAND_QUEUE_SIZE> c1Commands;
+extern spscQueue<deviceActionRequest, COMMAND_QUEUE_SIZE> c0Commands;
 
 extern promMetrics metrics;
 
@@ -101,12 +163,19 @@ uint32_t timeSync(void *param);
 uint32_t checkEthernet(void *param);
 void     initLogData();
 uint32_t logData(void *param);
+uint32_t writeLog(void *param);
 void     syncDeviceInfo();
-uint32_t syncDevices(void *param);
 uint32_t syncState(void *param);
 uint32_t deviceActionTask(void *param);
+bool     sendDeviceAction(const deviceActionRequest &action);
+void     configChanged();
+uint32_t commandTask(void *param);
+uint32_t scanTask(void *param);
 uint32_t addDeviceFromButton(void *param);
+void     requestReboot();
+int      findAvailableChannelLocked();
 
 void collect();
+void publishLive();
 
 #endif //FIRMWARE_AURAMON_H
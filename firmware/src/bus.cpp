@@ -0,0 +1,297 @@
+//
+// Created by Nicholas Wiersma on 2026/03/06.
+//
+
+#ifndef UNIT_TEST
+#include "auramon.h"
+#else
+#include "../test/stubs/TestAuraMon.h"
+#include "bus.h"
+#endif
+
+uint16_t modbusCRC(const uint8_t *buf, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+modbusBus::modbusBus(HardwareSerial &serial, int8_t dePin)
+    : _serial(serial),
+      _dePin(dePin),
+      _baud(0),
+      _timeoutMS(100),
+      _frameUS(0),
+      _state(Idle),
+      _status(MODBUS_OK),
+      _exception(0),
+      _id(0),
+      _fc(0),
+      _addr(0),
+      _value(0),
+      _expected(0),
+      _len(0),
+      _sentUS(0),
+      _lastUS(0),
+      _buf{} {
+}
+
+void modbusBus::begin(uint32_t baud) {
+    _serial.begin(baud);
+    if (_dePin >= 0) {
+        pinMode(_dePin, OUTPUT);
+        digitalWrite(_dePin, LOW);
+    }
+
+    // The spec fixes the inter-frame gap above 19200 baud, otherwise
+    // it is 3.5 characters of 11 bits.
+    _baud = baud;
+    _frameUS = baud > 19200 ? 1750 : 38500000UL / baud;
+    _state = Idle;
+
+    stats.baud.store(baud, std::memory_order_relaxed);
+}
+
+uint8_t modbusBus::startRead(uint8_t id, uint16_t addr, uint16_t quantity) {
+    if (_state != Idle) {
+        return MODBUS_BUSY;
+    }
+    if (id == 0 || id > 247) {
+        return MODBUS_INVALID_ID;
+    }
+    if (quantity == 0 || quantity > 125) {
+        return MODBUS_INVALID_QUANTITY;
+    }
+
+    _id = id;
+    _fc = 0x04;
+    _addr = addr;
+    _value = quantity;
+    _buf[0] = id;
+    _buf[1] = _fc;
+    _buf[2] = addr >> 8;
+    _buf[3] = addr & 0xFF;
+    _buf[4] = quantity >> 8;
+    _buf[5] = quantity & 0xFF;
+    return send(6, 5 + quantity * 2);
+}
+
+uint8_t modbusBus::startWrite(uint8_t id, uint16_t addr, uint16_t value) {
+    if (_state != Idle) {
+        return MODBUS_BUSY;
+    }
+    if (id > 247) {
+        return MODBUS_INVALID_ID;
+    }
+
+    _id = id;
+    _fc = 0x06;
+    _addr = addr;
+    _value = value;
+    _buf[0] = id;
+    _buf[1] = _fc;
+    _buf[2] = addr >> 8;
+    _buf[3] = addr & 0xFF;
+    _buf[4] = value >> 8;
+    _buf[5] = value & 0xFF;
+    return send(6, 8);
+}
+
+uint8_t modbusBus::startWriteMultiple(uint8_t id, uint16_t addr, const uint16_t *values, uint16_t quantity) {
+    if (_state != Idle) {
+        return MODBUS_BUSY;
+    }
+    if (id > 247) {
+        return MODBUS_INVALID_ID;
+    }
+    if (!values) {
+        return MODBUS_INVALID_BUFFER;
+    }
+    if (quantity == 0 || quantity > 123) {
+        return MODBUS_INVALID_QUANTITY;
+    }
+
+    _id = id;
+    _fc = 0x10;
+    _addr = addr;
+    _value = quantity;
+    _buf[0] = id;
+    _buf[1] = _fc;
+    _buf[2] = addr >> 8;
+    _buf[3] = addr & 0xFF;
+    _buf[4] = quantity >> 8;
+    _buf[5] = quantity & 0xFF;
+    _buf[6] = quantity * 2;
+    for (uint16_t i = 0; i < quantity; i++) {
+        _buf[7 + i * 2] = values[i] >> 8;
+        _buf[8 + i * 2] = values[i] & 0xFF;
+    }
+    return send(7 + quantity * 2, 8);
+}
+
+uint8_t modbusBus::send(uint8_t len, uint16_t expected) {
+    const uint16_t crc = modbusCRC(_buf, len);
+    _buf[len++] = crc & 0xFF;
+    _buf[len++] = crc >> 8;
+
+    // Drop anything left over from an earlier exchange.
+    while (_serial.available()) {
+        _serial.read();
+    }
+
+    // Keep the bus silent for a frame gap between exchanges.
+    const uint32_t quietUS = micros() - _lastUS;
+    if (quietUS < _frameUS) {
+        delayMicroseconds(_frameUS - quietUS);
+    }
+
+    if (_dePin >= 0) {
+        digitalWrite(_dePin, HIGH);
+    }
+    _serial.write(_buf, len);
+    _serial.flush();
+    if (_dePin >= 0) {
+        digitalWrite(_dePin, LOW);
+    }
+
+    stats.bytes.fetch_add(len, std::memory_order_relaxed);
+
+    _sentUS = micros();
+    _lastUS = _sentUS;
+    _len = 0;
+    _exception = 0;
+
+    if (_id == 0) {
+        // Broadcasts are not answered.
+        _status = MODBUS_OK;
+        return MODBUS_OK;
+    }
+
+    _expected = expected;
+    _status = MODBUS_BUSY;
+    _state = Waiting;
+    return MODBUS_OK;
+}
+
+bool modbusBus::poll() {
+    if (_state != Waiting) {
+        return false;
+    }
+
+    while (_len < _expected && _serial.available()) {
+        _buf[_len++] = _serial.read();
+        _lastUS = micros();
+
+        // Exception responses are always 5 bytes.
+        if (_len == 2 && _buf[1] == (_fc | 0x80)) {
+            _expected = 5;
+        }
+    }
+
+    if (_len >= _expected) {
+        stats.bytes.fetch_add(_len, std::memory_order_relaxed);
+        _status = validate();
+        _state = Idle;
+        return false;
+    }
+
+    if (micros() - _sentUS >= _timeoutMS * 1000) {
+        stats.bytes.fetch_add(_len, std::memory_order_relaxed);
+        _status = _len > 0 ? MODBUS_FRAME_ERROR : MODBUS_RESPONSE_TIMEOUT;
+        _state = Idle;
+        return false;
+    }
+
+    return true;
+}
+
+uint8_t modbusBus::validate() {
+    const uint16_t crc = _buf[_len - 2] | _buf[_len - 1] << 8;
+    if (modbusCRC(_buf, _len - 2) != crc) {
+        return MODBUS_CRC_ERROR;
+    }
+    if (_buf[0] != _id) {
+        return MODBUS_UNEXPECTED_ID;
+    }
+    if (_buf[1] == (_fc | 0x80)) {
+        _exception = _buf[2];
+        return MODBUS_EXCEPTION_RESPONSE;
+    }
+    if (_buf[1] != _fc) {
+        return MODBUS_UNEXPECTED_FUNCTION_CODE;
+    }
+
+    const uint16_t addr = _buf[2] << 8 | _buf[3];
+    const uint16_t value = _buf[4] << 8 | _buf[5];
+    switch (_fc) {
+        case 0x04:
+            if (_buf[2] != _value * 2) {
+                return MODBUS_UNEXPECTED_BYTE_COUNT;
+            }
+            break;
+        case 0x06:
+            if (addr != _addr) {
+                return MODBUS_UNEXPECTED_ADDRESS;
+            }
+            if (value != _value) {
+                return MODBUS_UNEXPECTED_VALUE;
+            }
+            break;
+        case 0x10:
+            if (addr != _addr) {
+                return MODBUS_UNEXPECTED_ADDRESS;
+            }
+            if (value != _value) {
+                return MODBUS_UNEXPECTED_QUANTITY;
+            }
+            break;
+        default:
+            break;
+    }
+    return MODBUS_OK;
+}
+
+void modbusBus::registers(uint16_t *buf, uint16_t quantity) const {
+    for (uint16_t i = 0; i < quantity; i++) {
+        buf[i] = _buf[3 + i * 2] << 8 | _buf[4 + i * 2];
+    }
+}
+
+uint8_t modbusBus::wait() {
+    while (poll()) {
+    }
+    return _status;
+}
+
+uint8_t modbusBus::readInputRegisters(uint8_t id, uint16_t addr, uint16_t *buf, uint16_t quantity) {
+    if (!buf) {
+        return MODBUS_INVALID_BUFFER;
+    }
+    if (const uint8_t err = startRead(id, addr, quantity)) {
+        return err;
+    }
+    if (const uint8_t err = wait()) {
+        return err;
+    }
+    registers(buf, quantity);
+    return MODBUS_OK;
+}
+
+uint8_t modbusBus::writeSingleHoldingRegister(uint8_t id, uint16_t addr, uint16_t value) {
+    if (const uint8_t err = startWrite(id, addr, value)) {
+        return err;
+    }
+    return wait();
+}
+
+uint8_t modbusBus::writeMultipleHoldingRegisters(uint8_t id, uint16_t addr, const uint16_t *values,
+                                                 uint16_t quantity) {
+    if (const uint8_t err = startWriteMultiple(id, addr, values, quantity)) {
+        return err;
+    }
+    return wait();
+}
@@ -0,0 +1,96 @@
+//
+// Created by Nicholas Wiersma on 2026/03/06.
+//
+
+#ifndef FIRMWARE_BUS_H
+#define FIRMWARE_BUS_H
+
+#include <atomic>
+
+// Status of a bus request. The order matches modbusErrStr.
+enum modbusStatus : uint8_t {
+    MODBUS_OK = 0,
+    MODBUS_INVALID_ID,
+    MODBUS_INVALID_BUFFER,
+    MODBUS_INVALID_QUANTITY,
+    MODBUS_RESPONSE_TIMEOUT,
+    MODBUS_FRAME_ERROR,
+    MODBUS_CRC_ERROR,
+    MODBUS_UNKNOWN_COMM_ERROR,
+    MODBUS_UNEXPECTED_ID,
+    MODBUS_EXCEPTION_RESPONSE,
+    MODBUS_UNEXPECTED_FUNCTION_CODE,
+    MODBUS_UNEXPECTED_RESPONSE_LENGTH,
+    MODBUS_UNEXPECTED_BYTE_COUNT,
+    MODBUS_UNEXPECTED_ADDRESS,
+    MODBUS_UNEXPECTED_VALUE,
+    MODBUS_UNEXPECTED_QUANTITY,
+    MODBUS_BUSY,
+};
+
+struct busStats {
+    std::atomic<uint32_t> baud{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint32_t> lastRunMs{0};
+    std::atomic<uint32_t> throughputBps{0};
+    std::atomic<uint32_t> fallbacks{0};
+};
+
+uint16_t modbusCRC(const uint8_t *buf, size_t len);
+
+// modbusBus is a Modbus RTU master on a single RS485 bus. Requests are
+// asynchronous so that several buses can wait on their meters at the same
+// time: start a request, then poll until it completes.
+class modbusBus {
+public:
+    modbusBus(HardwareSerial &serial, int8_t dePin);
+
+    void     begin(uint32_t baud);
+    uint32_t baud() const { return _baud; }
+    void     setTimeout(uint32_t timeoutMS) { _timeoutMS = timeoutMS; }
+    uint32_t timeout() const { return _timeoutMS; }
+    // Time from the end of the request to the last byte of the response.
+    uint32_t responseUS() const { return _lastUS - _sentUS; }
+
+    uint8_t startRead(uint8_t id, uint16_t addr, uint16_t quantity);
+    uint8_t startWrite(uint8_t id, uint16_t addr, uint16_t value);
+    uint8_t startWriteMultiple(uint8_t id, uint16_t addr, const uint16_t *values, uint16_t quantity);
+    bool    poll();
+    uint8_t result() const { return _status; }
+    void    registers(uint16_t *buf, uint16_t quantity) const;
+
+    uint8_t readInputRegisters(uint8_t id, uint16_t addr, uint16_t *buf, uint16_t quantity);
+    uint8_t writeSingleHoldingRegister(uint8_t id, uint16_t addr, uint16_t value);
+    uint8_t writeMultipleHoldingRegisters(uint8_t id, uint16_t addr, const uint16_t *values, uint16_t quantity);
+    uint8_t getExceptionResponse() const { return _exception; }
+
+    busStats stats;
+
+private:
+    enum state : uint8_t { Idle, Waiting };
+
+    HardwareSerial &_serial;
+    int8_t          _dePin;
+    uint32_t        _baud;
+    uint32_t        _timeoutMS;
+    uint32_t        _frameUS;
+
+    state    _state;
+    uint8_t  _status;
+    uint8_t  _exception;
+    uint8_t  _id;
+    uint8_t  _fc;
+    uint16_t _addr;
+    uint16_t _value; // Written value or quantity.
+    uint16_t _expected;
+    uint16_t _len;
+    uint32_t _sentUS;
+    uint32_t _lastUS;
+    uint8_t  _buf[256];
+
+    uint8_t send(uint8_t len, uint16_t expected);
+    uint8_t validate();
+    uint8_t wait();
+};
+
+#endif //FIRMWARE_BUS_H
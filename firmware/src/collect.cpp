@@ -4,76 +4,172 @@
 
 #include "auramon.h"
 
-uint8_t readFrame(inputDevice *device);
-float   float_abcd(uint16_t hi, uint16_t lo);
+// busPoll walks the enabled devices on one bus, one request at a time.
+struct busPoll {
+    uint8_t       bus;
+    size_t        next;
+    inputDevice * dev;
+    uint8_t       block;
+    unsigned long start;
+    bool          done;
+    uint32_t      deviceCount;
+    uint64_t      deviceTimeMs;
+    uint32_t      reads;
+    uint32_t      corrupt;
+    uint16_t      regs[maxMeterRegisters];
+};
+
+bool    startDevice(busPoll &p);
+bool    stepDevice(busPoll &p);
+uint8_t startBlock(busPoll &p);
+void    applyReading(inputDevice *device, const meterReading &r);
 
 void collect() {
     const unsigned long startTotal = millis();
-    uint32_t            deviceCount = 0;
-    uint64_t            deviceTimeMs = 0;
+    busPoll             polls[MODBUS_BUSES] = {};
+    uint64_t            bytesStart[MODBUS_BUSES];
 
-    for (const auto dev : devices) {
-        if (!dev || !dev->isEnabled()) {
-            continue;
-        }
-
-        const unsigned long start = millis();
-
-        if (const uint8_t err = readFrame(dev); err) {
-            metrics.modbus_errors_total.fetch_add(1, std::memory_order_relaxed);
-            LOGE("Could not read data from device %d: %s", dev->addr, modbusError(err));
+    for (uint8_t b = 0; b < MODBUS_BUSES; b++) {
+        polls[b].bus = b;
+        bytesStart[b] = buses[b].stats.bytes.load(std::memory_order_relaxed);
+    }
 
-            continue;
+    // Each bus has its own UART, so requests on different buses
+    // are in flight at the same time.
+    uint8_t running = MODBUS_BUSES;
+    while (running > 0) {
+        for (auto &p: polls) {
+            if (p.done) {
+                continue;
+            }
+            if (!stepDevice(p)) {
+                continue;
+            }
+
+            p.done = true;
+            running--;
+
+            const unsigned long took = millis() - startTotal;
+            modbusBus &         bus = buses[p.bus];
+            const uint64_t      bytes = bus.stats.bytes.load(std::memory_order_relaxed) - bytesStart[p.bus];
+            const uint32_t      bps = took > 0 ? static_cast<uint32_t>(bytes * 1000ULL / took) : 0;
+            bus.stats.lastRunMs.store(took, std::memory_order_relaxed);
+            bus.stats.throughputBps.store(bps, std::memory_order_relaxed);
+            LOGD("Collecting bus %d took %dms", p.bus, took);
         }
 
-        deviceCount++;
-        const unsigned long took = millis() - start;
-        deviceTimeMs += took;
-
-        bucket curr = dev->current;
-        LOGD("%d: %.0fV %.3fW %.2fVA %.2fHz in %dms", dev->addr, curr.volts, curr.watts, curr.va, curr.hz, took);
-
         rp2040.wdt_reset();
     }
 
     const unsigned long tookTotal = millis() - startTotal;
     LOGD("Collecting data took %dms", tookTotal);
 
+    uint32_t deviceCount = 0;
+    uint64_t deviceTimeMs = 0;
+    for (const auto &p: polls) {
+        deviceCount += p.deviceCount;
+        deviceTimeMs += p.deviceTimeMs;
+    }
+
     metrics.modbus_collect_time_ms_total.fetch_add(tookTotal, std::memory_order_relaxed);
     const uint32_t avgMs = deviceCount > 0 ? static_cast<uint32_t>(deviceTimeMs / deviceCount) : 0;
     metrics.modbus_last_run_avg_ms.store(avgMs, std::memory_order_relaxed);
+
+    for (const auto &p: polls) {
+        checkBusErrors(p.bus, p.reads, p.corrupt);
+    }
 }
 
-uint8_t readFrame(inputDevice *device) {
-    uint16_t data[10];
-    if (const uint8_t err = modbus.readInputRegisters(device->addr, 0x4E20, data, 10)) {
-        return err;
+// stepDevice advances the poll on a bus, returning true once every device has been read.
+bool stepDevice(busPoll &p) {
+    if (!p.dev) {
+        return !startDevice(p);
     }
 
-    float v = float_abcd(data[0], data[1]);
-    float a = float_abcd(data[2], data[3]);
-    float pf = float_abcd(data[6], data[7]);
-    float hz = float_abcd(data[8], data[9]);
+    modbusBus &bus = buses[p.bus];
+    if (bus.poll()) {
+        return false;
+    }
 
-    double volts = v * device->calibration;
-    if (device->reversed) {
-        volts = -volts;
-        a = -a;
+    uint8_t err = bus.result();
+    if (!err) {
+        const registerBlock &b = p.dev->driver->blocks[p.block];
+        bus.registers(p.regs + b.offset, b.count);
+        if (++p.block < p.dev->driver->blockCount) {
+            err = startBlock(p);
+            if (!err) {
+                return false;
+            }
+        }
     }
-    double va = volts * a;
-    double watts = va * pf;
 
-    device->setEnergy(volts, watts, va, hz);
+    inputDevice *dev = p.dev;
+    p.dev = nullptr;
+    p.reads++;
+
+    if (err) {
+        if (isCorruptFrame(err)) {
+            p.corrupt++;
+        }
+        metrics.modbus_errors_total.fetch_add(1, std::memory_order_relaxed);
+        LOGE("Could not read data from device %d: %s", dev->addr, modbusError(bus, err));
 
-    return 0;
+        return false;
+    }
+
+    meterReading r;
+    dev->driver->decode(p.regs, r);
+    applyReading(dev, r);
+
+    const unsigned long took = millis() - p.start;
+    p.deviceCount++;
+    p.deviceTimeMs += took;
+
+    const uint8_t ch = dev->channel;
+    LOGD("%d: %.0fV %.3fW %.2fVA %.2fHz in %dms", dev->addr, channels.volts(ch), channels.watts(ch), channels.va(ch),
+         channels.hz(ch), took);
+
+    return false;
 }
 
-float float_abcd(uint16_t hi, uint16_t lo) {
-    float    f;
-    uint32_t i;
+// startDevice sends the first request to the next enabled device on the bus.
+bool startDevice(busPoll &p) {
+    while (p.next < activeDeviceCount) {
+        inputDevice *dev = activeDevices[p.next++];
+        if (dev->bus != p.bus) {
+            continue;
+        }
 
-    i = ((uint32_t) hi << 16) + lo;
-    memcpy(&f, &i, sizeof(float));
+        p.dev = dev;
+        p.block = 0;
+        p.start = millis();
+        if (const uint8_t err = startBlock(p); err) {
+            p.dev = nullptr;
+            p.reads++;
+            metrics.modbus_errors_total.fetch_add(1, std::memory_order_relaxed);
+            LOGE("Could not read data from device %d: %s", dev->addr, modbusError(buses[p.bus], err));
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+uint8_t startBlock(busPoll &p) {
+    const registerBlock &b = p.dev->driver->blocks[p.block];
+    return buses[p.bus].startRead(p.dev->addr, b.start, b.count);
+}
+
+void applyReading(inputDevice *device, const meterReading &r) {
+    float a = r.amps;
+    float volts = r.volts * device->calibration;
+    if (device->reversed) {
+        volts = -volts;
+        a = -a;
+    }
+    const float va = volts * a;
+    const float watts = va * r.pf;
 
-    return f;
+    device->setEnergy(volts, watts, va, r.hz);
+    device->setCounters(r.importKWh, r.exportKWh);
 }
@@ -69,50 +69,51 @@ void writeNetworkConfigToJson(JsonObject obj) {
     obj["dns"] = netCfg.dns.c_str();
 }
 
-inputDeviceInfo *ensureDeviceInfo(uint8_t address) {
-    if (address == 0 || address > MAX_DEVICES) {
+inputDeviceInfo *ensureDeviceInfo(uint8_t channel, uint8_t address) {
+    if (channel >= MAX_DEVICES || address == 0 || address > 247) {
         return nullptr;
     }
-    const size_t idx = address - 1;
-    if (!deviceInfos[idx]) {
-        deviceInfos[idx] = new inputDeviceInfo(address);
-    }
-    return deviceInfos[idx];
-}
-
-void removeDevicesFromLocked(size_t startIdx) {
-    if (startIdx >= MAX_DEVICES) {
-        return;
-    }
-
-    for (size_t i = startIdx; i < MAX_DEVICES; i++) {
-        if (deviceInfos[i]) {
-            delete deviceInfos[i];
-            deviceInfos[i] = nullptr;
-        }
+    if (!deviceInfos[channel]) {
+        deviceInfos[channel] = new inputDeviceInfo(channel, address);
     }
+    return deviceInfos[channel];
 }
 
 void applyDevicesFromJson(JsonArrayConst devicesArr) {
+    bool seen[MAX_DEVICES] = {};
+
     mutex_enter_blocking(&deviceInfoMu);
-    removeDevicesFromLocked(devicesArr.size());
 
     for (JsonVariantConst entry: devicesArr) {
         if (!entry.is<JsonObjectConst>()) {
             continue;
         }
         uint8_t          addr = entry["address"].is<int>() ? entry["address"].as<uint8_t>() : 0;
-        inputDeviceInfo *info = ensureDeviceInfo(addr);
-        if (!info) {
+        // Configs without channels map each address to its own channel.
+        uint8_t          channel = entry["channel"].is<int>() ? entry["channel"].as<uint8_t>() : addr - 1;
+        inputDeviceInfo *info = ensureDeviceInfo(channel, addr);
+        if (!info || seen[channel]) {
             continue;
         }
+        seen[channel] = true;
         info->enabled = entry["enabled"].is<bool>() ? entry["enabled"].as<bool>() : false;
         info->addr = addr;
+        info->bus = entry["bus"].is<uint8_t>() ? entry["bus"].as<uint8_t>() : 0;
+        if (info->bus >= MODBUS_BUSES) {
+            info->bus = 0;
+        }
         info->calibration = entry["calibration"].is<float>() ? entry["calibration"].as<float>() : 1.0f;
         info->reversed = entry["reversed"].is<bool>() ? entry["reversed"].as<bool>() : false;
         info->name = entry["name"].is<const char *>() ? strdup(entry["name"].as<const char *>()) : nullptr;
     }
 
+    for (size_t i = 0; i < MAX_DEVICES; i++) {
+        if (deviceInfos[i] && !seen[i]) {
+            delete deviceInfos[i];
+            deviceInfos[i] = nullptr;
+        }
+    }
+
     mutex_exit(&deviceInfoMu);
 }
 
@@ -126,7 +127,9 @@ void populateDevicesJson(JsonArray devicesArray) {
         }
         JsonObject device = devicesArray.add<JsonObject>();
         device["enabled"] = info->enabled;
+        device["channel"] = info->channel;
         device["address"] = info->addr;
+        device["bus"] = info->bus;
         device["name"] = info->name;
         device["calibration"] = info->calibration;
         device["reversed"] = info->reversed;
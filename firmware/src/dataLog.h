@@ -5,30 +5,56 @@
 
 #include <errors.h>
 
-// Total of 384 bytes.
+// A total of 24 bytes plus 24 bytes per channel, 384 bytes with 15 channels.
+// Totals are milli units integrated over milliseconds, e.g. mW·ms.
 struct logRecord {
     uint32_t rev;
-    uint32_t ts;       // Unix Timestamp
-    double   logHours; // Total hours observed in this record.
-    double   hzHrs;
-    double   voltHrs[15];
-    double   wattHrs[15];
-    double   vaHrs[15];
+    uint32_t ts;    // Unix Timestamp
+    int64_t  logMs; // Total milliseconds observed in this record.
+    int64_t  hzMs;
+    int64_t  voltMs[MAX_DEVICES];
+    int64_t  wattMs[MAX_DEVICES];
+    int64_t  vaMs[MAX_DEVICES];
 
     logRecord() : rev(0),
                   ts(0),
-                  logHours(0),
-                  hzHrs(0),
-                  voltHrs{},
-                  wattHrs{},
-                  vaHrs{} {
+                  logMs(0),
+                  hzMs(0),
+                  voltMs{},
+                  wattMs{},
+                  vaMs{} {
     };
 };
 
+// logHeader starts the datalog file and records the schema of its records.
+// Version 1 records held floating point hours, version 2 fixed point milliseconds.
+struct logHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t channels;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+constexpr uint32_t logMagic = 0x474C4D41; // "AMLG"
+constexpr uint16_t logVersion = 2;
+constexpr uint16_t legacyLogChannels = 15; // Logs written before the header.
+
+// logStats is the extent of the log, read under one lock.
+struct logStats {
+    uint32_t entries;
+    uint32_t firstRev;
+    uint32_t firstTS;
+    uint32_t lastRev;
+    uint32_t lastTS;
+    uint32_t fileSize;
+};
+
 class dataLog {
 public:
     explicit dataLog(int interval = 5, double days = 180.0) : _interval(interval),
                                                          _recordSize(sizeof(logRecord)),
+                                                         _dataStart(0),
                                                          _fileSize(0),
                                                          _maxFileSize(0),
                                                          _entries(0),
@@ -52,7 +78,9 @@ public:
     uint32_t lastRev();
     uint32_t lastTS();
     uint32_t fileSize();
+    logStats stats();
     error *  read(uint32_t ts, logRecord *rec, uint32_t timeoutMS = 100);
+    error *  readFrom(uint32_t ts, uint32_t rev, logRecord *rec, uint32_t timeoutMS = 100);
     error *  write(logRecord *rec);
 
 private:
@@ -66,6 +94,7 @@ private:
     FsFile   _file;
     uint16_t _interval;
     uint16_t _recordSize;
+    uint32_t _dataStart; // Offset of the first record, after the header.
 
     uint32_t     _fileSize;
     uint32_t     _maxFileSize;
@@ -82,6 +111,9 @@ private:
     uint32_t   _lastCachePos = 0;
     logRecord *_lastCache; // The last 60s of records.
 
+    bool         openFile();
+    bool         migrateFile(uint32_t start);
+    static bool  freeOldPath(char *path, size_t len);
     logRecordKey readKey(uint32_t pos);
     uint8_t      readRev(uint32_t rev, logRecord *rec);
     void         search(uint32_t ts, logRecord * rec,
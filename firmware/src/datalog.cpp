@@ -18,13 +18,12 @@ bool dataLog::begin() {
         msgDir.remove(msgDir.indexOf('/', 1));
         sd.mkdir(msgDir.c_str());
     }
-    _file = sd.open(DATA_LOG_PATH, O_RDWR | O_CREAT);
-    if (!_file) {
+    if (!openFile()) {
         mutex_exit(&sdMu);
         return false;
     }
 
-    _fileSize = _file.size();
+    _fileSize = _file.size() - _dataStart;
     _maxFileSize = max(_fileSize, _maxFileSize);
     if (_fileSize) {
         _first = readKey(0);
@@ -36,10 +35,8 @@ bool dataLog::begin() {
 
     if (_first.ts > _last.ts) {
         _wrapPos = findWrapPos(0, _first.ts, _fileSize - _recordSize, _last.ts);
-        _file.seek(_wrapPos);
-        _file.read(&_first, sizeof(logRecordKey));
-        _file.seek(_wrapPos - _recordSize);
-        _file.read(&_last, sizeof(logRecordKey));
+        _first = readKey(_wrapPos);
+        _last = readKey(_wrapPos - _recordSize);
     }
 
     if (_fileSize && _last.rev - _first.rev + 1 != _entries) {
@@ -54,6 +51,143 @@ bool dataLog::begin() {
     return true;
 }
 
+// openFile opens the log and checks its schema. A version 1 log with the
+// same channels is migrated, any other schema is moved aside and a new log
+// started.
+bool dataLog::openFile() {
+    // A migration cut short after its result was written.
+    if (!sd.exists(DATA_LOG_PATH) && sd.exists(DATA_LOG_NEW_PATH)) {
+        sd.rename(DATA_LOG_NEW_PATH, DATA_LOG_PATH);
+    }
+
+    _file = sd.open(DATA_LOG_PATH, O_RDWR | O_CREAT);
+    if (!_file) {
+        return false;
+    }
+
+    const uint32_t size = _file.size();
+    logHeader      hdr{};
+    if (size >= sizeof(logHeader)) {
+        _file.seek(0);
+        _file.read(&hdr, sizeof(logHeader));
+    }
+
+    if (hdr.magic == logMagic && hdr.version == logVersion && hdr.channels == MAX_DEVICES &&
+        hdr.recordSize == _recordSize) {
+        _dataStart = sizeof(logHeader);
+        return true;
+    }
+
+    if (size > 0) {
+        // Logs without a header hold version 1 records.
+        const bool     headed = hdr.magic == logMagic;
+        const uint16_t version = headed ? hdr.version : 1;
+        const uint16_t channels = headed ? hdr.channels : legacyLogChannels;
+        LOGE("log: %s has version %d with %d channels, expected version %d with %d.\r\n", DATA_LOG_PATH,
+             version, channels, logVersion, MAX_DEVICES);
+
+        _file.close();
+        if (version == 1 && channels == MAX_DEVICES && (!headed || hdr.recordSize == _recordSize)) {
+            LOGI("log: Migrating %s to version %d.\r\n", DATA_LOG_PATH, logVersion);
+            if (migrateFile(headed ? sizeof(logHeader) : 0)) {
+                _file = sd.open(DATA_LOG_PATH, O_RDWR);
+                _dataStart = sizeof(logHeader);
+                return static_cast<bool>(_file);
+            }
+        }
+
+        char oldPath[32];
+        if (!freeOldPath(oldPath, sizeof(oldPath))) {
+            LOGE("log: No free name to move %s to.\r\n", DATA_LOG_PATH);
+            return false;
+        }
+        LOGE("log: Moving %s to %s.\r\n", DATA_LOG_PATH, oldPath);
+        sd.rename(DATA_LOG_PATH, oldPath);
+        _file = sd.open(DATA_LOG_PATH, O_RDWR | O_CREAT);
+        if (!_file) {
+            return false;
+        }
+    }
+
+    hdr = logHeader{logMagic, logVersion, MAX_DEVICES, _recordSize, 0};
+    _file.seek(0);
+    _file.write(&hdr, sizeof(logHeader));
+    _file.flush();
+    _dataStart = sizeof(logHeader);
+    return true;
+}
+
+// migrateRecord converts a version 1 record in place. Version 1 held
+// floating point hours in the same positions, version 2 holds milli units
+// integrated over milliseconds.
+static void migrateRecord(logRecord *rec) {
+    auto convert = [](int64_t *field, double scale) {
+        double hours;
+        memcpy(&hours, field, sizeof(hours));
+        *field = std::isfinite(hours) ? llround(hours * scale) : 0;
+    };
+
+    convert(&rec->logMs, MS_PER_HOUR);
+    convert(&rec->hzMs, 1000.0 * MS_PER_HOUR);
+    for (uint8_t ch = 0; ch < MAX_DEVICES; ch++) {
+        convert(&rec->voltMs[ch], 1000.0 * MS_PER_HOUR);
+        convert(&rec->wattMs[ch], 1000.0 * MS_PER_HOUR);
+        convert(&rec->vaMs[ch], 1000.0 * MS_PER_HOUR);
+    }
+}
+
+// migrateFile writes the version 1 records from start in the log to a new
+// version 2 log, keeping their order so the wrap position is unchanged, then
+// swaps it in. The version 1 log is kept unless an older log holds its name.
+bool dataLog::migrateFile(uint32_t start) {
+    FsFile in = sd.open(DATA_LOG_PATH, O_RDONLY);
+    FsFile out = sd.open(DATA_LOG_NEW_PATH, O_RDWR | O_CREAT | O_TRUNC);
+    if (!in || !out) {
+        return false;
+    }
+
+    const logHeader hdr{logMagic, logVersion, MAX_DEVICES, _recordSize, 0};
+    bool            ok = out.write(&hdr, sizeof(logHeader)) == sizeof(logHeader);
+    auto            rec = new logRecord;
+    uint32_t        records = 0;
+    in.seek(start);
+    while (ok && in.read(rec, _recordSize) == _recordSize) {
+        migrateRecord(rec);
+        ok = out.write(rec, _recordSize) == _recordSize;
+        records++;
+    }
+    delete rec;
+    in.close();
+    ok = out.flush() && ok;
+    out.close();
+
+    if (!ok) {
+        LOGE("log: Could not write %s.\r\n", DATA_LOG_NEW_PATH);
+        sd.remove(DATA_LOG_NEW_PATH);
+        return false;
+    }
+    if (!sd.exists(DATA_LOG_OLD_PATH)) {
+        sd.rename(DATA_LOG_PATH, DATA_LOG_OLD_PATH);
+    } else {
+        sd.remove(DATA_LOG_PATH);
+    }
+    LOGI("log: Migrated %d records.\r\n", records);
+    return sd.rename(DATA_LOG_NEW_PATH, DATA_LOG_PATH);
+}
+
+// freeOldPath finds a name to move the log aside to without replacing an
+// earlier one.
+bool dataLog::freeOldPath(char *path, size_t len) {
+    snprintf(path, len, "%s", DATA_LOG_OLD_PATH);
+    for (uint8_t i = 1; sd.exists(path); i++) {
+        if (i == 100) {
+            return false;
+        }
+        snprintf(path, len, "%s.%d", DATA_LOG_OLD_PATH, i);
+    }
+    return true;
+}
+
 uint32_t dataLog::entries() {
     mutex_enter_blocking(&_mu);
     auto e = _entries;
@@ -96,6 +230,13 @@ uint32_t dataLog::fileSize() {
     return s;
 }
 
+logStats dataLog::stats() {
+    mutex_enter_blocking(&_mu);
+    const logStats s{_entries, _first.rev, _first.ts, _last.rev, _last.ts, _fileSize};
+    mutex_exit(&_mu);
+    return s;
+}
+
 error *dataLog::read(uint32_t ts, logRecord *rec, uint32_t timeoutMS) {
     ts -= ts % _interval;
 
@@ -187,6 +328,28 @@ error *dataLog::read(uint32_t ts, logRecord *rec, uint32_t timeoutMS) {
     return nullptr;
 }
 
+// readFrom reads the record for ts, trying rev first. Sequential readers
+// pass the rev they expect next and skip the search while the log has no gaps.
+error *dataLog::readFrom(uint32_t ts, uint32_t rev, logRecord *rec, uint32_t timeoutMS) {
+    ts -= ts % _interval;
+
+    if (timeoutMS > 0) {
+        if (!mutex_enter_timeout_ms(&_mu, timeoutMS)) {
+            return newError("mutex timeout");
+        }
+    } else {
+        mutex_enter_blocking(&_mu);
+    }
+
+    if (_file && _entries > 0 && readRev(rev, rec) == 0 && rec->ts == ts) {
+        mutex_exit(&_mu);
+        return nullptr;
+    }
+    mutex_exit(&_mu);
+
+    return read(ts, rec, timeoutMS);
+}
+
 error *dataLog::write(logRecord *rec) {
     mutex_enter_blocking(&_mu);
 
@@ -208,15 +371,13 @@ error *dataLog::write(logRecord *rec) {
     if (_wrapPos || _fileSize >= _maxFileSize) {
         // The file has/should wrap.
         mutex_enter_blocking(&sdMu);
-        _file.seek(_wrapPos);
+        _file.seek(_dataStart + _wrapPos);
         _wrapPos = (_wrapPos + _recordSize) % _fileSize;
         _file.write(rec, _recordSize);
         _file.flush();
 
         // Read the new first key.
-        auto key = logRecordKey{};
-        _file.read(&key, sizeof(logRecordKey));
-        _first = key;
+        _first = readKey(_wrapPos);
         mutex_exit(&sdMu);
 
         metrics.datalog_io.fetch_add(1, std::memory_order_relaxed);
@@ -227,7 +388,7 @@ error *dataLog::write(logRecord *rec) {
 
     // No wrap, just write at the end of the file.
     mutex_enter_blocking(&sdMu);
-    _file.seek(_fileSize);
+    _file.seek(_dataStart + _fileSize);
     _file.write(rec, _recordSize);
     _file.flush();
     mutex_exit(&sdMu);
@@ -248,7 +409,7 @@ error *dataLog::write(logRecord *rec) {
 
 dataLog::logRecordKey dataLog::readKey(uint32_t pos) {
     auto key = logRecordKey{};
-    _file.seek(pos);
+    _file.seek(_dataStart + pos);
     _file.read(&key, sizeof(logRecordKey));
     return key;
 }
@@ -261,7 +422,7 @@ uint8_t dataLog::readRev(uint32_t rev, logRecord *rec) {
     uint32_t pos = ((rev - _first.rev) * _recordSize + _wrapPos) % _fileSize;
 
     mutex_enter_blocking(&sdMu);
-    _file.seek(pos);
+    _file.seek(_dataStart + pos);
     _file.read(rec, _recordSize);
     mutex_exit(&sdMu);
 
@@ -2,7 +2,11 @@
 // Created by Nicholas Wiersma on 2025/09/26.
 //
 
+#ifndef UNIT_TEST
 #include "auramon.h"
+#else
+#include "../test/stubs/TestAuraMon.h"
+#endif
 
 void inputDevice::reset() {
     enabled = false;
@@ -10,24 +14,93 @@ void inputDevice::reset() {
     name = nullptr;
     calibration = 0;
     reversed = false;
+    counter = energyCounter();
 }
 
 void inputDevice::accumulate(uint32_t now) {
-    if (now <= current.ts) {
+    channels.accumulate(channel, now);
+}
+
+void inputDevice::setEnergy(float volts, float watts, float va, float hz) {
+    channels.set(channel, volts, watts, va, hz);
+    channels.accumulate(channel, millis());
+}
+
+void inputDevice::setCounters(float importKWh, float exportKWh) {
+    const uint32_t now = millis();
+    if (!std::isfinite(importKWh) || !std::isfinite(exportKWh)) {
+        counter.valid = false;
         return;
     }
-    const double hrs = static_cast<double>(now - current.ts) / MS_PER_HOUR;
-    current.voltHrs += current.volts * hrs;
-    current.wattHrs += current.watts * hrs;
-    current.vaHrs += current.va * hrs;
-    current.hzHrs += current.hz * hrs;
-    current.ts = now;
-}
-
-void inputDevice::setEnergy(double volts, double watts, double va, double hz) {
-    current.volts = volts;
-    current.watts = watts;
-    current.va = va;
-    current.hz = hz;
-    accumulate(millis());
+    const int64_t importMWh = llroundf(importKWh * 1e6f);
+    const int64_t exportMWh = llroundf(exportKWh * 1e6f);
+
+    // The counters only step every few watt hours. Until they do, keep
+    // integrating; once they step, the delta since the last step replaces
+    // what was integrated over it.
+    if (counter.valid && importMWh == counter.importMWh && exportMWh == counter.exportMWh) {
+        return;
+    }
+
+    // Only trust the counters when they moved forward by a plausible amount,
+    // otherwise keep the integrated value and start again from here.
+    const int64_t mWh = (importMWh - counter.importMWh) - (exportMWh - counter.exportMWh);
+    const int64_t maxMWh = static_cast<int64_t>(METER_MAX_WATTS) * (now - counter.ts) / 3600;
+    if (counter.valid && importMWh >= counter.importMWh && exportMWh >= counter.exportMWh &&
+        llabs(mWh) <= maxMWh) {
+        // Watts keep the meter's sign on reversed channels, see applyReading,
+        // so the counters do too.
+        const int64_t wattMs = llroundf(static_cast<float>(mWh) * calibration) * MS_PER_HOUR;
+        channels.wattMs[channel] = counter.wattMs + wattMs;
+    }
+
+    counter.valid = true;
+    counter.importMWh = importMWh;
+    counter.exportMWh = exportMWh;
+    counter.wattMs = channels.wattMs[channel];
+    counter.ts = now;
+}
+
+// clear drops the channel's sample so nothing more is integrated for it.
+// The totals are kept so the last deltas still reach the log.
+void channelState::clear(uint8_t ch, uint32_t now) {
+    mV[ch] = 0;
+    mW[ch] = 0;
+    mVA[ch] = 0;
+    mHz[ch] = 0;
+    ts[ch] = now;
+}
+
+void channelState::set(uint8_t ch, float volts, float watts, float va, float hz) {
+    mV[ch] = lroundf(volts * 1000.0f);
+    mW[ch] = lroundf(watts * 1000.0f);
+    mVA[ch] = lroundf(va * 1000.0f);
+    mHz[ch] = lroundf(hz * 1000.0f);
+}
+
+void channelState::accumulate(uint8_t ch, uint32_t now) {
+    const int32_t ms = static_cast<int32_t>(now - ts[ch]);
+    if (ms <= 0) {
+        return;
+    }
+    voltMs[ch] += static_cast<int64_t>(mV[ch]) * ms;
+    wattMs[ch] += static_cast<int64_t>(mW[ch]) * ms;
+    vaMs[ch] += static_cast<int64_t>(mVA[ch]) * ms;
+    hzMs[ch] += static_cast<int64_t>(mHz[ch]) * ms;
+    ts[ch] = now;
+}
+
+// accumulateAll brings every channel up to now. It is branch free so the
+// compiler can vectorise it; channels without a device have no sample and
+// add nothing.
+void channelState::accumulateAll(uint32_t now) {
+    for (uint8_t ch = 0; ch < MAX_DEVICES; ch++) {
+        int32_t ms = static_cast<int32_t>(now - ts[ch]);
+        ms = ms > 0 ? ms : 0;
+        voltMs[ch] += static_cast<int64_t>(mV[ch]) * ms;
+        wattMs[ch] += static_cast<int64_t>(mW[ch]) * ms;
+        vaMs[ch] += static_cast<int64_t>(mVA[ch]) * ms;
+        hzMs[ch] += static_cast<int64_t>(mHz[ch]) * ms;
+        ts[ch] = ms > 0 ? now : ts[ch];
+    }
 }
@@ -5,34 +5,72 @@
 #ifndef FIRMWARE_CHANNEL_H
 #define FIRMWARE_CHANNEL_H
 
-struct bucket {
-    double   volts;
-    double   watts;
-    double   va;
-    double   hz;
-    double   voltHrs;
-    double   wattHrs;
-    double   vaHrs;
-    double   hzHrs;
+#include "meter.h"
+
+// channelState is the live state of every channel, laid out as parallel
+// arrays indexed by channel so that per-channel passes are tight loops over
+// packed data. Samples are kept in milli units and totals in milli units
+// times milliseconds (e.g. mW·ms), so integration is exact integer math.
+// Only touched on core 1.
+struct channelState {
+    int32_t  mV[MAX_DEVICES];
+    int32_t  mW[MAX_DEVICES];
+    int32_t  mVA[MAX_DEVICES];
+    int32_t  mHz[MAX_DEVICES];
+    int64_t  voltMs[MAX_DEVICES];
+    int64_t  wattMs[MAX_DEVICES];
+    int64_t  vaMs[MAX_DEVICES];
+    int64_t  hzMs[MAX_DEVICES];
+    uint32_t ts[MAX_DEVICES];
+
+    // Totals when the last log record was written.
+    int64_t loggedVoltMs[MAX_DEVICES];
+    int64_t loggedWattMs[MAX_DEVICES];
+    int64_t loggedVaMs[MAX_DEVICES];
+
+    channelState() : mV{}, mW{}, mVA{}, mHz{}, voltMs{}, wattMs{}, vaMs{}, hzMs{}, ts{},
+                     loggedVoltMs{}, loggedWattMs{}, loggedVaMs{} {
+    }
+
+    void clear(uint8_t ch, uint32_t now);
+    void set(uint8_t ch, float volts, float watts, float va, float hz);
+    void accumulate(uint8_t ch, uint32_t now);
+    void accumulateAll(uint32_t now);
+
+    float volts(uint8_t ch) const { return mV[ch] * 0.001f; }
+    float watts(uint8_t ch) const { return mW[ch] * 0.001f; }
+    float va(uint8_t ch) const { return mVA[ch] * 0.001f; }
+    float hz(uint8_t ch) const { return mHz[ch] * 0.001f; }
+};
+
+// energyCounter tracks the meter's own energy registers so that
+// watt hours can be taken from counter deltas instead of integration.
+struct energyCounter {
+    bool     valid;
+    int64_t  importMWh;
+    int64_t  exportMWh;
+    int64_t  wattMs; // Channel total when the counters last stepped.
     uint32_t ts;
 
-    bucket() : volts(0), watts(0), va(0), hz(0),
-               voltHrs(0), wattHrs(0), vaHrs(0), hzHrs(0),
-               ts(millis()) {
+    energyCounter() : valid(false), importMWh(0), exportMWh(0), wattMs(0), ts(0) {
     }
 };
 
 class inputDeviceInfo {
 public:
     bool        enabled;
+    uint8_t     channel; // Position in the datalog record.
     uint8_t     addr;
+    uint8_t     bus;
     const char *name;
     float       calibration;
     bool        reversed;
 
-    inputDeviceInfo(uint8_t addr)
+    inputDeviceInfo(uint8_t channel, uint8_t addr)
         : enabled(false),
+          channel(channel),
           addr(addr),
+          bus(0),
           name(nullptr),
           calibration(1.0f),
           reversed(false) {
@@ -43,30 +81,41 @@ public:
 
 class inputDevice : public inputDeviceInfo {
 public:
-    bucket current;
+    energyCounter      counter;
+    const meterDriver *driver;
 
-    inputDevice(uint8_t addr) : inputDeviceInfo(addr) {
+    inputDevice(uint8_t channel, uint8_t addr) : inputDeviceInfo(channel, addr), driver(nullptr) {
     }
 
     ~inputDevice() = default;
     void reset();
     void accumulate(uint32_t now);
-    void setEnergy(double volts, double watts, double va, double hz);
+    void setEnergy(float volts, float watts, float va, float hz);
+    void setCounters(float importKWh, float exportKWh);
 };
 
-struct inputDeviceData {
-    const char *name;
-    double volts;
-    double amps;
-    double pf;
-    double hz;
+// channelReading is a channel's latest sample as shown on /status.
+struct channelReading {
+    float volts;
+    float amps;
+    float pf;
+    float hz;
+};
+
+// liveData is published by core 1 after every collection.
+struct liveData {
+    uint32_t       ms; // millis() when it was collected.
+    channelReading channels[MAX_DEVICES];
 };
 
-enum class deviceActionType : uint8_t { None = 0, Locate, Assign };
+// Sync tells core 1 the device config changed, Save asks core 0 to write it.
+enum class deviceActionType : uint8_t { None = 0, Locate, Assign, Negotiate, Scan, Sync, Save };
 
 struct deviceActionRequest {
     deviceActionType type;
     uint8_t          address;
+    uint8_t          bus;
+    uint32_t         epoch; // Config epoch of a Sync.
 };
 
 #endif //FIRMWARE_CHANNEL_H
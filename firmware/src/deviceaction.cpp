@@ -4,37 +4,88 @@
 
 #include "auramon.h"
 
-uint32_t deviceActionTask(void *param) {
-    (void) param;
+// The config epoch is only touched on core 0, core 1 keeps the last one it applied.
+static uint32_t configEpoch = 0;
+static uint32_t sentEpoch = 0;
+static uint32_t appliedEpoch = 0;
+
+// sendDeviceAction queues an action for core 1, returning false when too many are waiting.
+bool sendDeviceAction(const deviceActionRequest &action) {
+    if (!c1Commands.push(action)) {
+        return false;
+    }
+    c1Queue.notify();
+    return true;
+}
+
+// configChanged tells core 1 to pick up the device config. Called on core 0
+// after deviceInfos changed.
+void configChanged() {
+    configEpoch++;
+    if (sendDeviceAction({deviceActionType::Sync, 0, 0, configEpoch})) {
+        sentEpoch = configEpoch;
+    }
+}
 
-    deviceActionRequest action{deviceActionType::None, 0};
-    bool                hasAction = false;
+// commandTask handles commands from core 1 and resends a config change
+// that did not fit in the queue.
+uint32_t commandTask(void *param) {
+    (void) param;
 
-    if (!mutex_enter_block_until(&deviceActionMu, 100)) {
-        LOGE("deviceActionTask: could not acquire deviceActionMu");
-        return 200;
+    if (sentEpoch != configEpoch && sendDeviceAction({deviceActionType::Sync, 0, 0, configEpoch})) {
+        sentEpoch = configEpoch;
     }
 
-    if (deviceActionData.type == deviceActionType::None) {
-        mutex_exit(&deviceActionMu);
-        return 1000;
+    deviceActionRequest cmd{};
+    while (c0Commands.pop(cmd)) {
+        if (cmd.type != deviceActionType::Save) {
+            continue;
+        }
+        if (auto err = saveConfig(); err) {
+            LOGE("Failed to save config: %s", err->Error());
+        }
     }
 
-    action = deviceActionData;
-    deviceActionData = {deviceActionType::None, 0};
-    hasAction = true;
-
-    mutex_exit(&deviceActionMu);
-
-    switch (action.type) {
-        case deviceActionType::Locate:
-            locateModbusDevice(action.address);
-            break;
-        case deviceActionType::Assign:
-            assignModbusAddress(action.address);
-            break;
-        default:
-            break;
+    // Normally woken by core 1, this is only a fallback.
+    return 1000;
+}
+
+// deviceActionTask handles commands from core 0. Config changes are applied
+// straight away, bus actions one per run so collection is not held up.
+uint32_t deviceActionTask(void *param) {
+    (void) param;
+
+    deviceActionRequest action{};
+    while (c1Commands.pop(action)) {
+        if (action.type == deviceActionType::Sync) {
+            if (action.epoch == appliedEpoch) {
+                continue;
+            }
+            mutex_enter_blocking(&deviceInfoMu);
+            syncDeviceInfo();
+            mutex_exit(&deviceInfoMu);
+            appliedEpoch = action.epoch;
+            continue;
+        }
+
+        switch (action.type) {
+            case deviceActionType::Locate:
+                locateModbusDevice(action.bus, action.address);
+                break;
+            case deviceActionType::Assign:
+                assignModbusAddress(action.bus, action.address);
+                break;
+            case deviceActionType::Negotiate:
+                negotiateBusSpeed(action.bus);
+                break;
+            case deviceActionType::Scan:
+                startBusScan(action.bus);
+                break;
+            default:
+                break;
+        }
+        // Come straight back for the rest.
+        return c1Commands.depth() > 0 ? 1 : 1000;
     }
 
     return 1000;
@@ -0,0 +1,67 @@
+//
+// Created by Nicholas Wiersma on 2026/03/02.
+//
+
+#ifndef UNIT_TEST
+#include "auramon.h"
+#else
+#include "../test/stubs/TestAuraMon.h"
+#include "../../src/dataLog.h"
+#endif
+#include "energy.h"
+
+#include <cstring>
+
+bool energyRow(const logRecord &prev, const logRecord &rec,
+               const uint8_t *chans, size_t count, double *values) {
+    const int64_t elapsedMs = rec.logMs - prev.logMs;
+    if (elapsedMs <= 0) {
+        return false;
+    }
+    // Totals are milli units times milliseconds.
+    const double perMilliMs = 1.0 / (1000.0 * elapsedMs);
+
+    *values++ = (rec.hzMs - prev.hzMs) * perMilliMs;
+
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t idx = chans[i];
+        const int64_t wattMs = rec.wattMs[idx] - prev.wattMs[idx];
+        const double  voltage = (rec.voltMs[idx] - prev.voltMs[idx]) * perMilliMs;
+        const double  power = wattMs * perMilliMs;
+        const double  apparentPower = (rec.vaMs[idx] - prev.vaMs[idx]) * perMilliMs;
+        double        energyWh = wattMs / (1000.0 * MS_PER_HOUR);
+        if (energyWh < 0) {
+            energyWh = 0;
+        }
+
+        *values++ = voltage;
+        *values++ = (voltage != 0.0) ? (apparentPower / voltage) : 0.0;
+        *values++ = power;
+        *values++ = energyWh;
+        *values++ = (apparentPower > 0.0) ? (power / apparentPower) : 0.0;
+    }
+    return true;
+}
+
+// Both cores are little endian, so values are copied as is.
+size_t packEnergyRow(uint32_t ts, const double *values, size_t devices, uint8_t *out) {
+    memcpy(out, &ts, sizeof(ts));
+    uint8_t *pos = out + sizeof(ts);
+
+    const size_t count = 1 + energyDeviceColumns * devices;
+    for (size_t i = 0; i < count; i++) {
+        const float value = std::isfinite(values[i]) ? static_cast<float>(values[i]) : NAN;
+        memcpy(pos, &value, sizeof(value));
+        pos += sizeof(value);
+    }
+    return pos - out;
+}
+
+size_t packEnergyMarker(uint32_t ts, uint32_t a, uint32_t b, size_t devices, uint8_t *out) {
+    const size_t size = energyRowSize(devices);
+    memset(out, 0, size);
+    memcpy(out, &ts, sizeof(ts));
+    memcpy(out + 4, &a, sizeof(a));
+    memcpy(out + 8, &b, sizeof(b));
+    return size;
+}
@@ -0,0 +1,52 @@
+//
+// Created by Nicholas Wiersma on 2026/03/02.
+//
+
+#ifndef FIRMWARE_ENERGY_H
+#define FIRMWARE_ENERGY_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct logRecord;
+
+// Values per device in an /energy row: volts, amps, watts, Wh and power factor.
+constexpr uint8_t energyDeviceColumns = 5;
+
+// energyRow fills values with the averages between two records: Hz, then
+// energyDeviceColumns values for each of the given channels. Returns false
+// if no time was logged between them.
+bool energyRow(const logRecord &prev, const logRecord &rec,
+               const uint8_t *chans, size_t count, double *values);
+
+// The binary /energy stream starts with an energyHeader, then for each device
+// its channel, name length and name. Rows follow, each a uint32 timestamp and
+// float32 values in energyRow order, NaN where there is no value. All fields
+// are little endian.
+struct energyHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t devices;
+    uint32_t interval;
+    uint32_t rowSize;
+};
+
+constexpr uint32_t energyMagic = 0x4E454D41; // "AMEN"
+constexpr uint16_t energyVersion = 1;
+
+// Rows with these timestamps are markers. A cursor carries the next start
+// and rev as uint32 in its first two values. An error ends the stream.
+constexpr uint32_t energyCursorTS = 0;
+constexpr uint32_t energyErrorTS = UINT32_MAX;
+
+constexpr size_t energyRowSize(size_t devices) {
+    return sizeof(uint32_t) + sizeof(float) * (1 + energyDeviceColumns * devices);
+}
+
+// packEnergyRow writes a binary row to out, returning its size.
+size_t packEnergyRow(uint32_t ts, const double *values, size_t devices, uint8_t *out);
+
+// packEnergyMarker writes a marker row to out, returning its size.
+size_t packEnergyMarker(uint32_t ts, uint32_t a, uint32_t b, size_t devices, uint8_t *out);
+
+#endif // FIRMWARE_ENERGY_H
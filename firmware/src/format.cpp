@@ -0,0 +1,67 @@
+//
+// Created by Nicholas Wiersma on 2026/03/04.
+//
+
+#include "format.h"
+
+#include <cmath>
+#include <cstdio>
+
+static constexpr double pow10s[formatFixedMaxPrecision + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+};
+
+size_t formatFixed(char *buf, double value, uint8_t precision) {
+    buf[0] = '\0';
+    if (!std::isfinite(value)) {
+        return 0;
+    }
+    if (precision > formatFixedMaxPrecision) {
+        precision = formatFixedMaxPrecision;
+    }
+
+    const bool   negative = std::signbit(value);
+    const double scale = pow10s[precision];
+    const double magnitude = std::fabs(value);
+
+    // Beyond 2^63 the integer path cannot hold the digits, leave those to printf.
+    if (magnitude * scale >= 9.2e18) {
+        return snprintf(buf, formatFixedSize, "%.*f", precision, value);
+    }
+
+    // Round half to even on the exact product, as printf does. The fma
+    // residual is exact, the rounded product alone can land on the wrong side
+    // of a tie, e.g. 1.005 * 100.
+    const double scaled = std::nearbyint(magnitude * scale);
+    const double residual = std::fma(magnitude, scale, -scaled);
+    uint64_t     digits = static_cast<uint64_t>(scaled);
+    if (residual > 0.5 || (residual == 0.5 && (digits & 1))) {
+        digits++;
+    } else if (residual < -0.5 || (residual == -0.5 && (digits & 1))) {
+        digits--;
+    }
+
+    // Write the digits backwards, then reverse them into place.
+    char   tmp[formatFixedSize];
+    size_t n = 0;
+    for (uint8_t i = 0; i < precision; i++) {
+        tmp[n++] = static_cast<char>('0' + digits % 10);
+        digits /= 10;
+    }
+    if (precision > 0) {
+        tmp[n++] = '.';
+    }
+    do {
+        tmp[n++] = static_cast<char>('0' + digits % 10);
+        digits /= 10;
+    } while (digits);
+    if (negative) {
+        tmp[n++] = '-';
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = tmp[n - 1 - i];
+    }
+    buf[n] = '\0';
+    return n;
+}
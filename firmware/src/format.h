@@ -0,0 +1,21 @@
+//
+// Created by Nicholas Wiersma on 2026/03/04.
+//
+
+#ifndef FIRMWARE_FORMAT_H
+#define FIRMWARE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Most decimals formatFixed writes, beyond this it rounds to this many.
+constexpr uint8_t formatFixedMaxPrecision = 9;
+// Buffer size that fits any formatFixed output and its terminator.
+constexpr size_t formatFixedSize = 32;
+
+// formatFixed writes value to buf with precision decimals, the same as
+// printf("%.*f"), and returns the length. Non-finite values write nothing.
+// Works in integers so no soft double printf or heap is involved.
+size_t formatFixed(char *buf, double value, uint8_t precision);
+
+#endif // FIRMWARE_FORMAT_H
@@ -0,0 +1,893 @@
+//
+// Created by Nicholas Wiersma on 2026/03/09.
+//
+
+#ifndef UNIT_TEST
+#include "auramon.h"
+#else
+#include "../test/stubs/TestAuraMon.h"
+#endif
+#include "http.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <strings.h>
+
+static uint32_t millisClock() {
+    return millis();
+}
+
+static const char *reasonPhrase(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 409: return "Conflict";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "";
+    }
+}
+
+static char *find(char *buf, size_t len, const char *seq, size_t seqLen) {
+    if (len < seqLen) {
+        return nullptr;
+    }
+    for (size_t i = 0; i <= len - seqLen; i++) {
+        if (buf[i] == seq[0] && memcmp(buf + i, seq, seqLen) == 0) {
+            return buf + i;
+        }
+    }
+    return nullptr;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// urlDecode decodes s in place, with '+' as a space when plus is set.
+static void urlDecode(char *s, bool plus) {
+    char *out = s;
+    for (; *s; s++) {
+        if (*s == '%' && hexValue(s[1]) >= 0 && hexValue(s[2]) >= 0) {
+            *out++ = static_cast<char>(hexValue(s[1]) << 4 | hexValue(s[2]));
+            s += 2;
+        } else if (*s == '+' && plus) {
+            *out++ = ' ';
+        } else {
+            *out++ = *s;
+        }
+    }
+    *out = '\0';
+}
+
+// hasToken reports whether a comma separated header value holds token.
+static bool hasToken(const char *value, const char *token) {
+    const size_t len = strlen(token);
+    while (value && *value) {
+        while (*value == ' ' || *value == '\t' || *value == ',') {
+            value++;
+        }
+        const char *end = strchr(value, ',');
+        size_t      n = end ? static_cast<size_t>(end - value) : strlen(value);
+        while (n > 0 && (value[n - 1] == ' ' || value[n - 1] == '\t')) {
+            n--;
+        }
+        if (n == len && strncasecmp(value, token, len) == 0) {
+            return true;
+        }
+        value = end;
+    }
+    return false;
+}
+
+static char *trim(char *s) {
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t')) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+// copyParam copies a header parameter value to out, without its quotes.
+static void copyParam(const char *value, char *out, size_t size) {
+    size_t n = strlen(value);
+    if (n >= 2 && value[0] == '"') {
+        value++;
+        n -= 2;
+    }
+    if (n >= size) {
+        n = size - 1;
+    }
+    memcpy(out, value, n);
+    out[n] = '\0';
+}
+
+const char *httpRequest::arg(const char *name) const {
+    for (uint8_t i = 0; i < argCount; i++) {
+        if (strcmp(argNames[i], name) == 0) {
+            return argValues[i];
+        }
+    }
+    return nullptr;
+}
+
+const char *httpRequest::header(const char *name) const {
+    for (uint8_t i = 0; i < headerCount; i++) {
+        if (strcasecmp(headerNames[i], name) == 0) {
+            return headerValues[i];
+        }
+    }
+    return nullptr;
+}
+
+void httpResponse::header(const char *name, const char *value) {
+    const size_t nameLen = strlen(name);
+    const size_t valueLen = strlen(value);
+    if (_conn->_extraLen + nameLen + valueLen + 4 > sizeof(_conn->_extraHeaders)) {
+        return;
+    }
+    char *p = _conn->_extraHeaders + _conn->_extraLen;
+    memcpy(p, name, nameLen);
+    p += nameLen;
+    *p++ = ':';
+    *p++ = ' ';
+    memcpy(p, value, valueLen);
+    p += valueLen;
+    *p++ = '\r';
+    *p++ = '\n';
+    _conn->_extraLen = p - _conn->_extraHeaders;
+}
+
+void httpResponse::send(int code, const char *type, const char *body, size_t len) {
+    _conn->respond(code, type, body, len, false);
+}
+
+void httpResponse::stream(int code, const char *type, httpProducer producer, void *ctx, httpRelease release) {
+    if (_conn->_responded) {
+        if (release) {
+            release(ctx);
+        }
+        return;
+    }
+    _conn->_producer = producer;
+    _conn->_ctx = ctx;
+    _conn->_release = release;
+    _conn->respond(code, type, nullptr, 0, true);
+}
+
+bool httpResponse::sent() const {
+    return _conn->_responded;
+}
+
+void httpConnection::begin(httpSocket *socket, uint32_t now) {
+    reset();
+    _served = 0;
+    _socket = socket;
+    _state = state::ReadHead;
+    _since = now;
+}
+
+void httpConnection::close() {
+    if (_state == state::ReadUpload && _uploadHandler) {
+        emitUpload(httpUploadStatus::Aborted, nullptr, 0);
+    }
+    if (_socket) {
+        _socket->close();
+        delete _socket;
+        _socket = nullptr;
+    }
+    reset();
+}
+
+void httpConnection::reset() {
+    if (_release) {
+        _release(_ctx);
+    }
+    if (!_bodyInPlace) {
+        free(_req.body);
+    }
+    free(_body);
+
+    _state = state::Closed;
+    _keepAlive = false;
+    _rxLen = 0;
+    _headLen = 0;
+    _contentLength = 0;
+    _received = 0;
+    _nextStart = 0;
+    _nextLen = 0;
+    _unparsed = false;
+    _bodyInPlace = false;
+    _overrun = false;
+    _req = httpRequest();
+    _res._conn = this;
+    _handler = nullptr;
+    _uploadHandler = nullptr;
+    _uploadState = uploadState::Preamble;
+    _delimiterLen = 0;
+    _partIsFile = false;
+    _upload = httpUpload();
+    _responded = false;
+    _extraLen = 0;
+    _txLen = 0;
+    _txSent = 0;
+    _body = nullptr;
+    _bodyLen = 0;
+    _bodySent = 0;
+    _producer = nullptr;
+    _ctx = nullptr;
+    _release = nullptr;
+    _writer.discard();
+    _chunked = false;
+    _finished = false;
+    _ended = false;
+}
+
+bool httpConnection::poll(httpServer &server, uint32_t now) {
+    if (!_socket) {
+        return false;
+    }
+
+    bool progress = false;
+    switch (_state) {
+        case state::ReadHead:
+            progress = readHead(server);
+            break;
+        case state::ReadBody:
+            progress = readBody();
+            break;
+        case state::ReadUpload:
+            progress = readUpload();
+            break;
+        default:
+            break;
+    }
+    if (progress) {
+        _since = now;
+    }
+
+    if (_state == state::Send) {
+        return send(now) || progress;
+    }
+
+    const uint32_t timeout = idle() ? httpIdleTimeoutMs : httpReadTimeoutMs;
+    if (!progress && (!_socket->connected() || now - _since > timeout)) {
+        close();
+        return true;
+    }
+    return progress;
+}
+
+bool httpConnection::readHead(httpServer &server) {
+    // Leave room for uploads to stream through after the head.
+    const size_t limit = httpRequestSize - httpUploadWindow - 1;
+    const size_t n = _socket->read(reinterpret_cast<uint8_t *>(_rx + _rxLen), limit - _rxLen);
+    // Pipelined bytes may already hold the whole head.
+    if (n == 0 && !_unparsed) {
+        return false;
+    }
+    _unparsed = false;
+    _rxLen += n;
+
+    char *end = find(_rx, _rxLen, "\r\n\r\n", 4);
+    if (!end) {
+        if (_rxLen == limit) {
+            respond(431, "text/plain", "", 0, false);
+        }
+        return n > 0;
+    }
+    _headLen = end - _rx + 4;
+    *end = '\0';
+
+    if (!parseHead()) {
+        _keepAlive = false;
+        respond(400, "text/plain", "", 0, false);
+        return true;
+    }
+
+    // Anything after the head is the body, then the next pipelined request.
+    size_t prefix = _rxLen - _headLen;
+    _nextStart = _headLen;
+    _nextLen = prefix;
+
+    if (_req.method == httpMethod::Options) {
+        _res.header("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
+        _res.header("Access-Control-Allow-Headers", "*");
+        respond(204, "text/plain", "", 0, false);
+        return true;
+    }
+
+    if (auto r = server.find(_req.path, _req.method); r) {
+        _handler = r->handler;
+        _uploadHandler = r->upload;
+    } else {
+        _handler = server._notFound;
+    }
+
+    if (_uploadHandler) {
+        const char *type = _req.header("Content-Type");
+        const char *boundary = type ? strstr(type, "boundary=") : nullptr;
+        if (!type || strncasecmp(type, "multipart/form-data", 19) != 0 || !boundary) {
+            respond(400, "application/json", "{\"error\":\"Expected multipart/form-data\"}", 40, false);
+            return true;
+        }
+        if (_contentLength == 0) {
+            _keepAlive = false;
+            respond(411, "text/plain", "", 0, false);
+            return true;
+        }
+        if (prefix > _contentLength) {
+            // A request pipelined behind an upload is dropped with the connection.
+            _rxLen = _headLen + _contentLength;
+            prefix = _contentLength;
+            _keepAlive = false;
+        }
+        // The window is reused for the upload, nothing is left over after it.
+        _nextLen = 0;
+        char value[71];
+        copyParam(boundary + 9, value, sizeof(value));
+        _delimiterLen = snprintf(_delimiter, sizeof(_delimiter), "\r\n--%s", value);
+
+        // The first delimiter has no CRLF in front of it, add one so they all look the same.
+        memmove(_rx + _headLen + 2, _rx + _headLen, prefix);
+        _rx[_headLen] = '\r';
+        _rx[_headLen + 1] = '\n';
+        _rxLen += 2;
+        _received = prefix;
+        _state = state::ReadUpload;
+        parseUpload();
+        return true;
+    }
+
+    if (_contentLength > 0) {
+        if (_contentLength > httpBodyMax) {
+            respond(413, "text/plain", "", 0, false);
+            return true;
+        }
+        _received = prefix < _contentLength ? prefix : _contentLength;
+        _nextLen = prefix - _received;
+        if (_headLen + _contentLength < httpRequestSize) {
+            // The body fits behind the head, so it is read and parsed in place.
+            _req.body = _rx + _headLen;
+            _bodyInPlace = true;
+            _nextStart = _headLen + _contentLength + 1;
+            // Make room for the terminator in front of a pipelined request.
+            memmove(_rx + _nextStart, _rx + _nextStart - 1, _nextLen);
+        } else {
+            _req.body = static_cast<char *>(malloc(_contentLength + 1));
+            if (!_req.body) {
+                respond(500, "text/plain", "", 0, false);
+                return true;
+            }
+            memcpy(_req.body, _rx + _headLen, _received);
+            _nextStart = _headLen + _received;
+        }
+        _state = state::ReadBody;
+        readBody();
+        return true;
+    }
+
+    dispatch();
+    return true;
+}
+
+bool httpConnection::parseHead() {
+    char *line = _rx;
+    char *next = strstr(line, "\r\n");
+    if (next) {
+        *next = '\0';
+        next += 2;
+    }
+
+    // Request line: method, target and version.
+    char *target = strchr(line, ' ');
+    if (!target) {
+        return false;
+    }
+    *target++ = '\0';
+    char *version = strchr(target, ' ');
+    if (!version) {
+        return false;
+    }
+    *version++ = '\0';
+    if (strncmp(version, "HTTP/1.", 7) != 0) {
+        return false;
+    }
+    _req.http10 = version[7] == '0';
+
+    if (strcmp(line, "GET") == 0) {
+        _req.method = httpMethod::Get;
+    } else if (strcmp(line, "POST") == 0) {
+        _req.method = httpMethod::Post;
+    } else if (strcmp(line, "OPTIONS") == 0) {
+        _req.method = httpMethod::Options;
+    }
+
+    char *query = strchr(target, '?');
+    if (query) {
+        *query++ = '\0';
+    }
+    urlDecode(target, false);
+    _req.path = target;
+
+    while (query && *query && _req.argCount < httpMaxArgs) {
+        char *name = query;
+        query = strchr(query, '&');
+        if (query) {
+            *query++ = '\0';
+        }
+        char *value = strchr(name, '=');
+        if (value) {
+            *value++ = '\0';
+        } else {
+            value = name + strlen(name);
+        }
+        urlDecode(name, true);
+        urlDecode(value, true);
+        _req.argNames[_req.argCount] = name;
+        _req.argValues[_req.argCount] = value;
+        _req.argCount++;
+    }
+
+    while (next && *next) {
+        line = next;
+        next = strstr(line, "\r\n");
+        if (next) {
+            *next = '\0';
+            next += 2;
+        }
+        char *value = strchr(line, ':');
+        if (!value || _req.headerCount == httpMaxHeaders) {
+            continue;
+        }
+        *value++ = '\0';
+        _req.headerNames[_req.headerCount] = trim(line);
+        _req.headerValues[_req.headerCount] = trim(value);
+        _req.headerCount++;
+    }
+
+    if (const char *length = _req.header("Content-Length"); length) {
+        _contentLength = strtoul(length, nullptr, 10);
+    }
+
+    // HTTP/1.1 keeps the connection unless told otherwise, HTTP/1.0 only when asked.
+    const char *connection = _req.header("Connection");
+    _keepAlive = _req.http10 ? hasToken(connection, "keep-alive") : !hasToken(connection, "close");
+    return true;
+}
+
+bool httpConnection::readBody() {
+    const size_t n = _socket->read(reinterpret_cast<uint8_t *>(_req.body + _received), _contentLength - _received);
+    _received += n;
+    if (_received < _contentLength) {
+        return n > 0;
+    }
+    _req.body[_contentLength] = '\0';
+    _req.bodyLen = _contentLength;
+    dispatch();
+    return true;
+}
+
+bool httpConnection::readUpload() {
+    const size_t free = httpRequestSize - _rxLen;
+    size_t       want = _contentLength - _received;
+    if (want > free) {
+        want = free;
+    }
+    const size_t n = want ? _socket->read(reinterpret_cast<uint8_t *>(_rx + _rxLen), want) : 0;
+    _rxLen += n;
+    _received += n;
+
+    parseUpload();
+
+    if (_received < _contentLength) {
+        return n > 0;
+    }
+    if (_uploadState != uploadState::Done) {
+        if (_uploadState == uploadState::PartData && _partIsFile) {
+            emitUpload(httpUploadStatus::Aborted, nullptr, 0);
+        }
+        _uploadState = uploadState::Done;
+    }
+    dispatch();
+    return true;
+}
+
+// parseUpload streams the multipart body in the window after the head,
+// keeping back anything that could be the start of a delimiter.
+bool httpConnection::parseUpload() {
+    const size_t cap = httpRequestSize - _headLen;
+    const size_t keep = _delimiterLen - 1;
+
+    auto consume = [this](size_t n) {
+        char *win = _rx + _headLen;
+        memmove(win, win + n, _rxLen - _headLen - n);
+        _rxLen -= n;
+    };
+
+    while (true) {
+        char * win = _rx + _headLen;
+        size_t len = _rxLen - _headLen;
+
+        switch (_uploadState) {
+            case uploadState::Preamble: {
+                char *d = find(win, len, _delimiter, _delimiterLen);
+                if (!d) {
+                    if (len > keep) {
+                        consume(len - keep);
+                    }
+                    return false;
+                }
+                consume(d - win + _delimiterLen);
+                _uploadState = uploadState::AfterDelimiter;
+                break;
+            }
+            case uploadState::AfterDelimiter:
+                if (len < 2) {
+                    return false;
+                }
+                if (win[0] == '-' && win[1] == '-') {
+                    consume(len);
+                    _uploadState = uploadState::Done;
+                    return true;
+                }
+                if (win[0] != '\r' || win[1] != '\n') {
+                    _uploadState = uploadState::Done;
+                    return false;
+                }
+                consume(2);
+                _uploadState = uploadState::PartHead;
+                break;
+            case uploadState::PartHead: {
+                char *end = find(win, len, "\r\n\r\n", 4);
+                if (!end) {
+                    if (len == cap) {
+                        _uploadState = uploadState::Done;
+                    }
+                    return false;
+                }
+                end[2] = '\0';
+                parsePartHead(win);
+                consume(end - win + 4);
+                if (_partIsFile) {
+                    emitUpload(httpUploadStatus::Start, nullptr, 0);
+                }
+                _uploadState = uploadState::PartData;
+                break;
+            }
+            case uploadState::PartData: {
+                char *d = find(win, len, _delimiter, _delimiterLen);
+                if (!d) {
+                    if (len > keep) {
+                        if (_partIsFile) {
+                            emitUpload(httpUploadStatus::Write, reinterpret_cast<uint8_t *>(win), len - keep);
+                        }
+                        consume(len - keep);
+                    }
+                    return false;
+                }
+                if (_partIsFile) {
+                    if (d > win) {
+                        emitUpload(httpUploadStatus::Write, reinterpret_cast<uint8_t *>(win), d - win);
+                    }
+                    emitUpload(httpUploadStatus::End, nullptr, 0);
+                }
+                consume(d - win + _delimiterLen);
+                _uploadState = uploadState::AfterDelimiter;
+                break;
+            }
+            case uploadState::Done:
+                consume(len);
+                return false;
+        }
+    }
+}
+
+bool httpConnection::parsePartHead(const char *head) {
+    _partName[0] = '\0';
+    _partFilename[0] = '\0';
+    _partIsFile = false;
+
+    const char *line = head;
+    while (line && *line) {
+        const char *next = strstr(line, "\r\n");
+        if (strncasecmp(line, "Content-Disposition:", 20) == 0) {
+            char disposition[192];
+            size_t n = next ? static_cast<size_t>(next - line) : strlen(line);
+            if (n >= sizeof(disposition)) {
+                n = sizeof(disposition) - 1;
+            }
+            memcpy(disposition, line, n);
+            disposition[n] = '\0';
+
+            // form-data; name="firmware"; filename="firmware.bin"
+            char *param = strtok(disposition + 20, ";");
+            while (param) {
+                param = trim(param);
+                if (strncmp(param, "name=", 5) == 0) {
+                    copyParam(param + 5, _partName, sizeof(_partName));
+                } else if (strncmp(param, "filename=", 9) == 0) {
+                    copyParam(param + 9, _partFilename, sizeof(_partFilename));
+                    _partIsFile = true;
+                }
+                param = strtok(nullptr, ";");
+            }
+        }
+        line = next ? next + 2 : nullptr;
+    }
+    return _partName[0] != '\0';
+}
+
+void httpConnection::emitUpload(httpUploadStatus status, const uint8_t *buf, size_t len) {
+    if (status == httpUploadStatus::Start) {
+        _upload.totalSize = 0;
+    }
+    _upload.status = status;
+    _upload.name = _partName;
+    _upload.filename = _partFilename;
+    _upload.buf = buf;
+    _upload.currentSize = len;
+    _upload.totalSize += len;
+    _uploadHandler(_req, _upload);
+}
+
+void httpConnection::dispatch() {
+    metrics.http_requests_total.fetch_add(1, std::memory_order_relaxed);
+
+    if (_handler) {
+        _handler(_req, _res);
+    }
+    if (!_responded) {
+        respond(500, "text/plain", "", 0, false);
+    }
+}
+
+void httpConnection::respond(int code, const char *type, const char *body, size_t len, bool stream) {
+    if (_responded) {
+        return;
+    }
+    _responded = true;
+    _served++;
+    // An unread body would be taken for the next request.
+    if (_received < _contentLength) {
+        _keepAlive = false;
+    }
+
+    if (len > 0) {
+        _body = static_cast<char *>(malloc(len));
+        if (_body) {
+            memcpy(_body, body, len);
+            _bodyLen = len;
+        } else {
+            code = 500;
+            len = 0;
+        }
+    }
+    writeHead(code, type, len, stream);
+    _state = state::Send;
+}
+
+void httpConnection::writeHead(int code, const char *type, size_t len, bool stream) {
+    int n = snprintf(_tx, sizeof(_tx), "HTTP/1.%c %d %s\r\nContent-Type: %s\r\n",
+                     _req.http10 ? '0' : '1', code, reasonPhrase(code), type);
+    if (stream) {
+        // HTTP/1.0 has no chunks, the body ends when the connection closes.
+        _chunked = !_req.http10;
+        if (_chunked) {
+            n += snprintf(_tx + n, sizeof(_tx) - n, "Transfer-Encoding: chunked\r\n");
+        } else {
+            _keepAlive = false;
+        }
+    } else if (code != 204 && code != 304) {
+        n += snprintf(_tx + n, sizeof(_tx) - n, "Content-Length: %u\r\n", static_cast<unsigned>(len));
+    }
+    n += snprintf(_tx + n, sizeof(_tx) - n, "Access-Control-Allow-Origin: *\r\n");
+    if (_keepAlive) {
+        n += snprintf(_tx + n, sizeof(_tx) - n, "Connection: keep-alive\r\nKeep-Alive: timeout=%u\r\n",
+                      static_cast<unsigned>(httpIdleTimeoutMs / 1000));
+    } else {
+        n += snprintf(_tx + n, sizeof(_tx) - n, "Connection: close\r\n");
+    }
+    if (n + _extraLen + 2 < sizeof(_tx)) {
+        memcpy(_tx + n, _extraHeaders, _extraLen);
+        n += _extraLen;
+    }
+    memcpy(_tx + n, "\r\n", 2);
+    _txLen = n + 2;
+    _txSent = 0;
+}
+
+void httpConnection::writeChunk(void *ctx, const char *data, size_t len) {
+    auto * c = static_cast<httpConnection *>(ctx);
+    size_t n = c->_txLen;
+    // The producer only runs once the send buffer is empty, so one chunk
+    // fits. A producer that makes a second in the same call has broken its
+    // contract, the chunk is refused and the response abandoned.
+    if (n != 0 || len > responseChunkSize) {
+        c->_overrun = true;
+        return;
+    }
+    if (c->_chunked) {
+        n += snprintf(c->_tx + n, sizeof(c->_tx) - n, "%X\r\n", static_cast<unsigned>(len));
+    }
+    memcpy(c->_tx + n, data, len);
+    n += len;
+    if (c->_chunked) {
+        memcpy(c->_tx + n, "\r\n", 2);
+        n += 2;
+    }
+    c->_txLen = n;
+}
+
+bool httpConnection::send(uint32_t now) {
+    bool    progress = false;
+    uint8_t sends = 0;
+
+    while (true) {
+        if (_txSent < _txLen) {
+            const size_t n = _socket->write(reinterpret_cast<uint8_t *>(_tx + _txSent), _txLen - _txSent);
+            _txSent += n;
+            progress |= n > 0;
+            if (_txSent < _txLen) {
+                break;
+            }
+            _txLen = 0;
+            _txSent = 0;
+            sends++;
+        }
+        if (_bodySent < _bodyLen) {
+            const size_t n = _socket->write(reinterpret_cast<uint8_t *>(_body + _bodySent), _bodyLen - _bodySent);
+            _bodySent += n;
+            progress |= n > 0;
+            if (_bodySent < _bodyLen) {
+                break;
+            }
+            continue;
+        }
+        if (_producer && !_finished) {
+            if (sends >= httpSendsPerPoll) {
+                break;
+            }
+            const size_t before = _writer.pending();
+            const bool   more = _producer(_ctx, _writer);
+            if (_overrun) {
+                close();
+                return true;
+            }
+            if (!more) {
+                _finished = true;
+                continue;
+            }
+            // Nothing made yet, e.g. the SD card is busy. Try again next poll.
+            if (_txLen == 0 && _writer.pending() == before) {
+                break;
+            }
+            continue;
+        }
+
+        if (_producer && !_ended) {
+            // The send buffer is empty again, so the last chunk and the terminator fit.
+            _writer.flush();
+            if (_chunked) {
+                memcpy(_tx + _txLen, "0\r\n\r\n", 5);
+                _txLen += 5;
+            }
+            _ended = true;
+            continue;
+        }
+
+        finish(now);
+        return true;
+    }
+
+    if (progress) {
+        _since = now;
+    } else if (!_socket->connected() || now - _since > httpSendTimeoutMs) {
+        close();
+        return true;
+    }
+    return progress;
+}
+
+// finish ends a sent response, keeping the connection for the next request if it can.
+void httpConnection::finish(uint32_t now) {
+    if (_keepAlive) {
+        next(now);
+        return;
+    }
+    close();
+}
+
+// next readies the connection for the following request. Bytes pipelined
+// behind the last request are moved to the front of the receive buffer.
+void httpConnection::next(uint32_t now) {
+    const size_t start = _nextStart;
+    const size_t len = _nextLen;
+    reset();
+    memmove(_rx, _rx + start, len);
+    _rxLen = len;
+    _unparsed = len > 0;
+    _state = state::ReadHead;
+    _since = now;
+}
+
+httpServer::httpServer(httpAcceptFunction accept, httpClock clock) : _accept(accept),
+                                                                     _clock(clock ? clock : millisClock) {
+}
+
+void httpServer::on(const char *path, httpMethod method, httpHandler handler, httpUploadHandler upload) {
+    if (_routeCount == httpMaxRoutes) {
+        return;
+    }
+    _routes[_routeCount++] = route{path, method, handler, upload};
+}
+
+const httpServer::route *httpServer::find(const char *path, httpMethod method) const {
+    for (uint8_t i = 0; i < _routeCount; i++) {
+        if (_routes[i].method == method && strcmp(_routes[i].path, path) == 0) {
+            return &_routes[i];
+        }
+    }
+    return nullptr;
+}
+
+bool httpServer::poll() {
+    const uint32_t now = _clock();
+    bool           progress = false;
+
+    while (true) {
+        // A free slot, or failing that the connection idle the longest.
+        httpConnection *slot = nullptr;
+        for (auto &c: _conns) {
+            if (!c.isOpen()) {
+                slot = &c;
+                break;
+            }
+            if (c.idle() && (!slot || now - c.since() > now - slot->since())) {
+                slot = &c;
+            }
+        }
+        if (!slot) {
+            break;
+        }
+        httpSocket *socket = _accept();
+        if (!socket) {
+            break;
+        }
+        if (slot->isOpen()) {
+            slot->close();
+        }
+        slot->begin(socket, now);
+        metrics.http_connections_total.fetch_add(1, std::memory_order_relaxed);
+        progress = true;
+    }
+
+    for (auto &c: _conns) {
+        progress |= c.poll(*this, now);
+    }
+    return progress;
+}
+
+uint8_t httpServer::connections() const {
+    uint8_t n = 0;
+    for (const auto &c: _conns) {
+        n += c.isOpen();
+    }
+    return n;
+}
@@ -0,0 +1,277 @@
+//
+// Created by Nicholas Wiersma on 2026/03/09.
+//
+
+#ifndef FIRMWARE_HTTP_H
+#define FIRMWARE_HTTP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "response.h"
+
+// Connections served at once. Each holds about 6 KB of buffers.
+constexpr uint8_t httpMaxConnections = 4;
+constexpr uint8_t httpMaxRoutes = 16;
+constexpr uint8_t httpMaxArgs = 8;
+constexpr uint8_t httpMaxHeaders = 16;
+// Receive buffer for the request line and headers. Uploads stream through
+// what is left after the headers, which is at least httpUploadWindow.
+constexpr size_t httpRequestSize = 2048;
+constexpr size_t httpUploadWindow = 512;
+// Largest request body read into memory. Uploads are streamed instead.
+constexpr size_t httpBodyMax = 16384;
+// Send buffer, fits the response head or one framed chunk.
+constexpr size_t httpTxSize = 1536;
+constexpr size_t httpExtraHeadersSize = 256;
+// Send buffers a connection may fill in one poll, so a fast client cannot
+// starve the others.
+constexpr uint8_t httpSendsPerPoll = 4;
+constexpr uint32_t httpReadTimeoutMs = 5000;
+constexpr uint32_t httpSendTimeoutMs = 10000;
+// How long a kept-alive connection may wait for its next request. Idle
+// connections are also dropped early when a new client needs the slot.
+constexpr uint32_t httpIdleTimeoutMs = 30000;
+
+enum class httpMethod : uint8_t {
+    Other,
+    Get,
+    Post,
+    Options,
+};
+
+// httpSocket is a connected client. On the device it wraps a WiFiClient.
+class httpSocket {
+public:
+    virtual ~httpSocket() = default;
+
+    // read returns the bytes read, 0 when nothing has arrived.
+    virtual size_t read(uint8_t *buf, size_t len) = 0;
+    // write returns the bytes the socket took without blocking.
+    virtual size_t write(const uint8_t *buf, size_t len) = 0;
+    virtual bool   connected() = 0;
+    virtual void   close() = 0;
+};
+
+// An accept function returns a newly connected client or nullptr.
+typedef httpSocket *(*httpAcceptFunction)();
+typedef uint32_t (*httpClock)();
+
+// httpRequest points into the connection's receive buffer and is only valid
+// while the handler runs.
+struct httpRequest {
+    httpMethod  method = httpMethod::Other;
+    bool        http10 = false;
+    const char *path = "";
+    char *      body = nullptr;
+    size_t      bodyLen = 0;
+
+    // arg returns the decoded query parameter, nullptr if it is missing.
+    const char *arg(const char *name) const;
+    bool        hasArg(const char *name) const { return arg(name) != nullptr; }
+    // header returns the value of a request header, nullptr if it is missing.
+    const char *header(const char *name) const;
+
+    uint8_t     argCount = 0;
+    const char *argNames[httpMaxArgs] = {};
+    const char *argValues[httpMaxArgs] = {};
+    uint8_t     headerCount = 0;
+    const char *headerNames[httpMaxHeaders] = {};
+    const char *headerValues[httpMaxHeaders] = {};
+};
+
+// An upload that closes before its request is dispatched ends with Aborted,
+// even after a part's End, so handlers can release what they hold.
+enum class httpUploadStatus : uint8_t {
+    Start,
+    Write,
+    End,
+    Aborted,
+};
+
+// httpUpload is a file part of a multipart/form-data request body.
+struct httpUpload {
+    httpUploadStatus status = httpUploadStatus::Start;
+    const char *     name = "";
+    const char *     filename = "";
+    const uint8_t *  buf = nullptr;
+    size_t           currentSize = 0;
+    size_t           totalSize = 0;
+};
+
+// A producer writes the next part of a streamed body, at most responseChunkSize
+// bytes a call. It returns false once the body is complete. A producer that
+// writes more has its connection closed.
+typedef bool (*httpProducer)(void *ctx, responseWriter &out);
+// A release function frees a producer's context when the response is done
+// or the client went away.
+typedef void (*httpRelease)(void *ctx);
+
+class httpConnection;
+
+class httpResponse {
+public:
+    // header adds a response header. Call it before send or stream.
+    void header(const char *name, const char *value);
+    void send(int code, const char *type, const char *body, size_t len);
+    void send(int code, const char *type, const char *body = "") { send(code, type, body, strlen(body)); }
+#ifndef UNIT_TEST
+    void send(int code, const char *type, const String &body) { send(code, type, body.c_str(), body.length()); }
+    void send(int code, const char *type, const __FlashStringHelper *body) {
+        send(code, type, reinterpret_cast<const char *>(body));
+    }
+#endif
+    // stream sends a chunked body made by producer. ctx is released once
+    // the response is done, even if stream fails.
+    void stream(int code, const char *type, httpProducer producer, void *ctx, httpRelease release);
+    bool sent() const;
+
+private:
+    friend class httpConnection;
+    httpConnection *_conn = nullptr;
+};
+
+typedef void (*httpHandler)(httpRequest &req, httpResponse &res);
+typedef void (*httpUploadHandler)(httpRequest &req, httpUpload &upload);
+
+class httpServer;
+
+// httpConnection serves one client as a state machine, never waiting on the socket.
+class httpConnection {
+public:
+    httpConnection() = default;
+    ~httpConnection() { close(); }
+    httpConnection(const httpConnection &) = delete;
+    httpConnection &operator=(const httpConnection &) = delete;
+
+    bool isOpen() const { return _socket != nullptr; }
+    // idle reports whether the connection is kept alive between requests.
+    bool     idle() const { return _state == state::ReadHead && _rxLen == 0 && _served > 0; }
+    uint32_t since() const { return _since; }
+    void begin(httpSocket *socket, uint32_t now);
+    // poll moves the connection on as far as the socket allows. Returns
+    // false if nothing could be done.
+    bool poll(httpServer &server, uint32_t now);
+    void close();
+
+private:
+    friend class httpResponse;
+
+    enum class state : uint8_t {
+        Closed,
+        ReadHead,
+        ReadBody,
+        ReadUpload,
+        Send,
+    };
+
+    enum class uploadState : uint8_t {
+        Preamble,
+        PartHead,
+        PartData,
+        AfterDelimiter,
+        Done,
+    };
+
+    httpSocket *_socket = nullptr;
+    state       _state = state::Closed;
+    uint32_t    _since = 0;
+    uint32_t    _served = 0; // Requests answered on this connection.
+    bool        _keepAlive = false;
+
+    char   _rx[httpRequestSize] = {};
+    size_t _rxLen = 0;
+    size_t _headLen = 0;
+    size_t _contentLength = 0;
+    size_t _received = 0;
+    bool   _bodyInPlace = false; // The body is in _rx rather than on the heap.
+    // Pipelined bytes of the next request, already in _rx.
+    size_t _nextStart = 0;
+    size_t _nextLen = 0;
+    bool   _unparsed = false;
+
+    httpRequest       _req;
+    httpResponse      _res;
+    httpHandler       _handler = nullptr;
+    httpUploadHandler _uploadHandler = nullptr;
+
+    // Multipart upload parsing.
+    uploadState _uploadState = uploadState::Preamble;
+    char        _delimiter[76] = {}; // CRLF, "--" and a boundary of up to 70 characters.
+    size_t      _delimiterLen = 0;
+    char        _partName[32] = {};
+    char        _partFilename[96] = {};
+    bool        _partIsFile = false;
+    httpUpload  _upload;
+
+    // Response.
+    bool         _responded = false;
+    char         _extraHeaders[httpExtraHeadersSize] = {};
+    size_t       _extraLen = 0;
+    char         _tx[httpTxSize] = {};
+    size_t       _txLen = 0;
+    size_t       _txSent = 0;
+    char *       _body = nullptr;
+    size_t       _bodyLen = 0;
+    size_t       _bodySent = 0;
+    httpProducer _producer = nullptr;
+    void *       _ctx = nullptr;
+    httpRelease  _release = nullptr;
+    bool         _chunked = false;
+    bool         _finished = false; // The producer has nothing more.
+    bool         _ended = false;    // The last chunk has been queued.
+    bool         _overrun = false;  // The producer made more than one chunk in a call.
+    // Only filled by the producer, so it needs no buffer of its own on the stack.
+    responseWriter _writer{writeChunk, this};
+
+    bool readHead(httpServer &server);
+    bool parseHead();
+    bool readBody();
+    bool readUpload();
+    bool parseUpload();
+    bool parsePartHead(const char *head);
+    void emitUpload(httpUploadStatus status, const uint8_t *buf, size_t len);
+    void dispatch();
+    bool send(uint32_t now);
+    void finish(uint32_t now);
+    void next(uint32_t now);
+    void respond(int code, const char *type, const char *body, size_t len, bool stream);
+    void writeHead(int code, const char *type, size_t len, bool stream);
+    void reset();
+
+    static void writeChunk(void *ctx, const char *data, size_t len);
+};
+
+class httpServer {
+public:
+    explicit httpServer(httpAcceptFunction accept, httpClock clock = nullptr);
+
+    void on(const char *path, httpMethod method, httpHandler handler, httpUploadHandler upload = nullptr);
+    void onNotFound(httpHandler handler) { _notFound = handler; }
+    // poll accepts waiting clients and moves every connection on. Returns
+    // false if nothing could be done.
+    bool    poll();
+    uint8_t connections() const;
+
+private:
+    friend class httpConnection;
+
+    struct route {
+        const char *      path;
+        httpMethod        method;
+        httpHandler       handler;
+        httpUploadHandler upload;
+    };
+
+    httpAcceptFunction _accept;
+    httpClock          _clock;
+    route              _routes[httpMaxRoutes] = {};
+    uint8_t            _routeCount = 0;
+    httpHandler        _notFound = nullptr;
+    httpConnection     _conns[httpMaxConnections];
+
+    const route *find(const char *path, httpMethod method) const;
+};
+
+#endif // FIRMWARE_HTTP_H
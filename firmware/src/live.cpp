@@ -0,0 +1,217 @@
+//
+// Created by Nicholas Wiersma on 2026/03/12.
+//
+
+#ifndef UNIT_TEST
+#include "auramon.h"
+#else
+#include "../test/stubs/TestAuraMon.h"
+#endif
+#include "live.h"
+#include "format.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// Only touched on core 0, like the connections serving it.
+static liveFrame *currentFrame = nullptr;
+static uint8_t    clientCount = 0;
+
+void releaseLiveFrame(liveFrame *f) {
+    if (--f->refs == 0) {
+        free(f->data);
+        delete f;
+    }
+}
+
+// frameWriter appends to a buffer sized up front for the whole frame.
+struct frameWriter {
+    char *p;
+
+    void write(const char *s, size_t n) {
+        memcpy(p, s, n);
+        p += n;
+    }
+
+    void write(const char *s) { write(s, strlen(s)); }
+
+    void writeFixed(double value, uint8_t precision) {
+        const size_t n = formatFixed(p, value, precision);
+        if (n == 0) {
+            write("null");
+            return;
+        }
+        p += n;
+    }
+
+    // writeString writes s as a JSON string.
+    void writeString(const char *s) {
+        *p++ = '"';
+        for (; *s; s++) {
+            const auto c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\') {
+                *p++ = '\\';
+                *p++ = static_cast<char>(c);
+            } else if (c < 0x20) {
+                static const char hex[] = "0123456789abcdef";
+                write("\\u00");
+                *p++ = hex[c >> 4];
+                *p++ = hex[c & 0xF];
+            } else {
+                *p++ = static_cast<char>(c);
+            }
+        }
+        *p++ = '"';
+    }
+};
+
+// encodeFrame encodes the latest sample of every named device, with the
+// same fields and precision as /status.
+static liveFrame *encodeFrame(uint32_t version) {
+    const liveData data = live.read();
+
+    mutex_enter_blocking(&deviceInfoMu);
+
+    // Every byte of a name may need escaping as \u00XX.
+    size_t size = 64;
+    for (const auto info: deviceInfos) {
+        if (info && info->name && info->name[0]) {
+            size += 6 * strlen(info->name) + 4 * formatFixedSize + 64;
+        }
+    }
+    auto buf = static_cast<char *>(malloc(size));
+    if (!buf) {
+        mutex_exit(&deviceInfoMu);
+        return nullptr;
+    }
+
+    frameWriter w{buf};
+    char        num[formatFixedSize];
+    w.write("id: ");
+    w.write(num, formatFixed(num, version, 0));
+    w.write("\ndata: {\"ms\":");
+    w.write(num, formatFixed(num, data.ms, 0));
+    w.write(",\"devices\":");
+    const size_t devicesStart = w.p - buf;
+    w.write("[");
+    bool first = true;
+    for (const auto info: deviceInfos) {
+        if (!info || !info->name || !info->name[0]) {
+            continue;
+        }
+        const channelReading &r = data.channels[info->channel];
+        w.write(first ? "{\"name\":" : ",{\"name\":");
+        first = false;
+        w.writeString(info->name);
+        w.write(",\"volts\":");
+        w.writeFixed(r.volts, 2);
+        w.write(",\"amps\":");
+        w.writeFixed(r.amps, 3);
+        w.write(",\"pf\":");
+        w.writeFixed(r.pf, 3);
+        w.write(",\"hz\":");
+        w.writeFixed(r.hz, 2);
+        w.write("}");
+    }
+    w.write("]");
+    const size_t devicesLen = w.p - buf - devicesStart;
+    w.write("}\n\n");
+
+    mutex_exit(&deviceInfoMu);
+
+    metrics.live_frames_total.fetch_add(1, std::memory_order_relaxed);
+    return new liveFrame{version, 1, static_cast<size_t>(w.p - buf), buf, devicesStart, devicesLen};
+}
+
+// latestFrame returns the frame of the newest sample, encoding it if no
+// client has asked for it yet.
+static liveFrame *latestFrame() {
+    const uint32_t version = live.version();
+    if (version == 0) {
+        return nullptr;
+    }
+    if (currentFrame && currentFrame->version == version) {
+        return currentFrame;
+    }
+    liveFrame *f = encodeFrame(version);
+    if (!f) {
+        return currentFrame;
+    }
+    if (currentFrame) {
+        releaseLiveFrame(currentFrame);
+    }
+    currentFrame = f;
+    return f;
+}
+
+liveClient *openLiveClient() {
+    if (clientCount >= liveMaxClients) {
+        return nullptr;
+    }
+    clientCount++;
+    return new liveClient{nullptr, 0, 0, static_cast<uint32_t>(millis())};
+}
+
+bool produceLive(void *ctx, responseWriter &out) {
+    auto           c = static_cast<liveClient *>(ctx);
+    const uint32_t now = millis();
+
+    if (!c->frame) {
+        liveFrame *f = latestFrame();
+        if (!f || f->version == c->version) {
+            if (now - c->lastWrite >= liveHeartbeatMs) {
+                out.write(":\n\n");
+                out.flush();
+                c->lastWrite = now;
+            }
+            return true;
+        }
+        // Samples that arrived while a frame was being sent are skipped.
+        f->refs++;
+        c->frame = f;
+        c->offset = 0;
+        c->version = f->version;
+    }
+
+    // One piece a call, so at most one chunk is made.
+    if (c->offset == c->frame->len) {
+        out.flush();
+        releaseLiveFrame(c->frame);
+        c->frame = nullptr;
+        c->lastWrite = now;
+        return true;
+    }
+    size_t       free;
+    char *       p = out.buffer(1, &free);
+    const size_t n = std::min(free, c->frame->len - c->offset);
+    memcpy(p, c->frame->data + c->offset, n);
+    out.commit(n);
+    c->offset += n;
+    return true;
+}
+
+void releaseLive(void *ctx) {
+    auto c = static_cast<liveClient *>(ctx);
+    if (c->frame) {
+        releaseLiveFrame(c->frame);
+    }
+    delete c;
+
+    // Nobody is listening, so the last frame is not worth keeping.
+    if (--clientCount == 0 && currentFrame) {
+        releaseLiveFrame(currentFrame);
+        currentFrame = nullptr;
+    }
+}
+
+liveFrame *acquireLiveFrame() {
+    liveFrame *f = latestFrame();
+    if (f) {
+        f->refs++;
+    }
+    return f;
+}
+
+uint8_t liveClients() {
+    return clientCount;
+}
@@ -0,0 +1,51 @@
+//
+// Created by Nicholas Wiersma on 2026/03/12.
+//
+
+#ifndef FIRMWARE_LIVE_H
+#define FIRMWARE_LIVE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "response.h"
+
+// /live streams are held open, so only a few of the connections may be used by them.
+constexpr uint8_t liveMaxClients = 2;
+// A comment is sent when there has been no sample for this long, so the
+// connection is not dropped as stalled.
+constexpr uint32_t liveHeartbeatMs = 5000;
+
+// liveFrame is one sample encoded as a server-sent event. It is encoded once
+// and shared by every client, and freed when the last one is done with it.
+struct liveFrame {
+    uint32_t version; // Snapshot version it was encoded from.
+    uint16_t refs;
+    size_t   len;
+    char *   data;
+    // The devices JSON array within data, which /status serves as well.
+    size_t devicesStart;
+    size_t devicesLen;
+};
+
+// liveClient is the state of one /live stream.
+struct liveClient {
+    liveFrame *frame;   // Being sent, nullptr between frames.
+    size_t     offset;  // Bytes of frame already written.
+    uint32_t   version; // Last sample sent.
+    uint32_t   lastWrite;
+};
+
+// openLiveClient returns a new stream, nullptr if liveMaxClients are open.
+liveClient *openLiveClient();
+// produceLive is the httpProducer of a /live stream. It never ends.
+bool    produceLive(void *ctx, responseWriter &out);
+void    releaseLive(void *ctx);
+uint8_t liveClients();
+
+// acquireLiveFrame returns the frame of the latest sample, nullptr if there
+// is none yet. Hand it back with releaseLiveFrame.
+liveFrame *acquireLiveFrame();
+void       releaseLiveFrame(liveFrame *f);
+
+#endif // FIRMWARE_LIVE_H
@@ -15,10 +15,7 @@ uint32_t logData(void *param) {
 
     static bool   running;
     static auto * rec = new logRecord;
-    static double hzHrs = 0;
-    static double voltHrs[15] = {};
-    static double wattHrs[15] = {};
-    static double vaHrs[15] = {};
+    static int64_t hzMs = 0;
     const auto    start = millis();
 
     // If the clock is not running, try again later.
@@ -49,43 +46,40 @@ uint32_t logData(void *param) {
     if (time(nullptr) < rec->ts) return 2;
 
     const uint32_t nowMS = millis();
-    const double   elapsedHrs = static_cast<double>(nowMS - lastMS) / MS_PER_HOUR;
-    double         currHZHrs = 0;
-    uint8_t        count = 0;
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        const auto dev = devices[i];
-        if (!dev || !dev->isEnabled()) {
-            voltHrs[i] = 0;
-            wattHrs[i] = 0;
-            vaHrs[i] = 0;
-            continue;
-        }
-
-        dev->accumulate(nowMS);
-        rec->voltHrs[i] += dev->current.voltHrs - voltHrs[i];
-        voltHrs[i] = dev->current.voltHrs;
-        rec->wattHrs[i] += dev->current.wattHrs - wattHrs[i];
-        wattHrs[i] = dev->current.wattHrs;
-        rec->vaHrs[i] += dev->current.vaHrs - vaHrs[i];
-        vaHrs[i] = dev->current.vaHrs;
-        currHZHrs += dev->current.hzHrs;
+    channels.accumulateAll(nowMS);
+    for (uint8_t ch = 0; ch < MAX_DEVICES; ch++) {
+        rec->voltMs[ch] += channels.voltMs[ch] - channels.loggedVoltMs[ch];
+        rec->wattMs[ch] += channels.wattMs[ch] - channels.loggedWattMs[ch];
+        rec->vaMs[ch] += channels.vaMs[ch] - channels.loggedVaMs[ch];
+    }
+    memcpy(channels.loggedVoltMs, channels.voltMs, sizeof(channels.voltMs));
+    memcpy(channels.loggedWattMs, channels.wattMs, sizeof(channels.wattMs));
+    memcpy(channels.loggedVaMs, channels.vaMs, sizeof(channels.vaMs));
+
+    int64_t currHzMs = 0;
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < activeDeviceCount; i++) {
+        currHzMs += channels.hzMs[activeDevices[i]->channel];
         count++;
     }
     if (count > 0) {
-        currHZHrs = currHZHrs / count;
+        currHzMs = currHzMs / count;
     }
-    rec->hzHrs += currHZHrs - hzHrs;
-    hzHrs = currHZHrs;
+    rec->hzMs += currHzMs - hzMs;
+    hzMs = currHzMs;
 
+    rec->logMs += nowMS - lastMS;
     lastMS = nowMS;
-    rec->logHours += elapsedHrs;
 
-    // Write the record.
-    datalog.write(rec);
+    // Hand the record to core 0, so a busy SD card never holds up collection.
+    if (logQueue.push(*rec)) {
+        c0Queue.notify();
+    } else {
+        LOGE("Log queue full, dropped record %d", rec->ts);
+    }
 
     const auto took = millis() - start;
-    // TODO: log the stats.
-    LOGD("Wrote record %d to log took %dms", rec->ts, took);
+    LOGD("Queued record %d took %dms", rec->ts, took);
 
     rec->ts += datalog.interval();
     if (rec->ts < time(nullptr)) {
@@ -94,3 +88,22 @@ uint32_t logData(void *param) {
     }
     return datalog.interval() * 1000 - took;
 }
+
+// writeLog drains the log queue to the SD card. It is the only writer of the datalog.
+uint32_t writeLog(void *param) {
+    (void) param;
+
+    logRecord rec;
+    while (logQueue.pop(rec)) {
+        const auto start = millis();
+        if (auto err = datalog.write(&rec); err) {
+            LOGE("Could not write record %d to log: %s", rec.ts, err->Error());
+            delete err;
+            continue;
+        }
+        LOGD("Wrote record %d to log took %dms", rec.ts, millis() - start);
+    }
+
+    // Normally woken by core 1, this is only a fallback.
+    return 1000;
+}
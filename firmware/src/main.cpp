@@ -20,25 +20,35 @@ bool      rtcRunning = false;
 Wiznet5500lwIP eth(PIN_SPI0_SS, SPI, ETH_INT);
 NetworkConfig  netCfg;
 
-mutex_t             deviceDataMu;
-inputDeviceData *   deviceData[MAX_DEVICES] = {};
-mutex_t             deviceActionMu;
-deviceActionRequest deviceActionControl = {deviceActionType::None, 0};
-deviceActionRequest deviceActionData = {deviceActionType::None, 0};
 mutex_t             deviceInfoMu;
-volatile bool       devicesChanged;
 inputDeviceInfo *   deviceInfos[MAX_DEVICES] = {};
 inputDevice *       devices[MAX_DEVICES] = {};
+inputDevice *       activeDevices[MAX_DEVICES] = {};
+uint8_t             activeDeviceCount = 0;
+channelState        channels;
+mutex_t             scanMu;
+busScan             scanResult;
+snapshot<liveData>  live;
 dataLog             datalog;
 
+spscQueue<logRecord, LOG_QUEUE_SIZE> logQueue;
+
+spscQueue<deviceActionRequest, COMMAND_QUEUE_SIZE> c1Commands;
+spscQueue<deviceActionRequest, COMMAND_QUEUE_SIZE> c0Commands;
+
 promMetrics metrics;
 
-ModbusRTUMaster modbus(Serial1, RS485_DE);
+#if MODBUS_BUSES > 1
+SerialPIO serial485(RS485_2_TX, RS485_2_RX);
+modbusBus buses[MODBUS_BUSES] = {{Serial1, RS485_DE}, {serial485, RS485_2_DE}};
+#else
+modbusBus buses[MODBUS_BUSES] = {{Serial1, RS485_DE}};
+#endif
 
-WebServer server(80);
+httpServer server(acceptClient);
 
-taskQueue c0Queue = {};
-taskQueue c1Queue = {};
+taskQueue c0Queue;
+taskQueue c1Queue;
 
 volatile bool setupComplete = false;
 
@@ -90,9 +100,8 @@ void setup() {
     }
     startTime = time(nullptr);
 
-    mutex_init(&deviceDataMu);
-    mutex_init(&deviceActionMu);
     mutex_init(&deviceInfoMu);
+    mutex_init(&scanMu);
 
     if (auto err = loadConfig(); err) {
         LOGI("Could not load config from SD Card: %s", err->Error());
@@ -129,22 +138,24 @@ void setup() {
 
     LOGI("Datalog initialised");
 
-    Serial1.begin(RS485_BAUDRATE);
-    modbus.begin(RS485_BAUDRATE);
-    modbus.setTimeout(60);
+    for (auto &bus: buses) {
+        bus.begin(RS485_BAUDRATE);
+        bus.setTimeout(60);
+    }
 
     LOGI("Modbus initialised");
 
     setupAPI();
-    server.begin();
 
-    c0Queue.add(timeSync, 5);
-    c0Queue.add(checkEthernet, 5);
-    c0Queue.add(syncState, 4);
+    c0Queue.add(timeSync, 5, "timeSync");
+    c0Queue.add(checkEthernet, 5, "checkEthernet");
+    c0Queue.add(syncState, 4, "syncState");
+    c0Queue.addOnNotify(writeLog, 6, "writeLog");
+    c0Queue.addOnNotify(commandTask, 5, "commandTask");
 
-    c1Queue.add(logData, 7);
-    c1Queue.add(syncDevices, 6);
-    c1Queue.add(deviceActionTask, 5);
+    c1Queue.add(logData, 7, "logData");
+    c1Queue.addOnNotify(deviceActionTask, 5, "deviceActionTask");
+    c1Queue.add(scanTask, 4, "scanTask");
 
     syncState(nullptr);
     ledTimer.attach(1, blinkLED);
@@ -153,11 +164,17 @@ void setup() {
 }
 
 void loop() {
-    server.handleClient();
+    static taskStats *httpStats = c0Queue.stats("http");
+
+    const uint32_t start = micros();
+    const bool     httpBusy = server.poll();
+    httpStats->record(micros() - start);
+
     handleButtonPress();
 
-    if (!c0Queue.runNextTask()) {
-        delay(10);
+    // Keep polling while responses are moving, they are not tasks.
+    if (!c0Queue.runNextTask() && !httpBusy) {
+        c0Queue.idle(IDLE_MAX_MS);
     }
 }
 
@@ -166,6 +183,10 @@ void setup1() {
         delay(10);
     }
 
+    for (uint8_t b = 0; b < MODBUS_BUSES; b++) {
+        detectBusSpeed(b);
+    }
+
     // Set the initial monotonic ts so we know
     // how long it took before the first log write.
     initLogData();
@@ -174,14 +195,23 @@ void setup1() {
 }
 
 void loop1() {
+    static taskStats *   collectStats = c1Queue.stats("collect");
+    static unsigned long due = millis();
+
     const unsigned long start = millis();
+    const uint32_t      startUS = micros();
 
     collect();
+    publishLive();
+
+    const int32_t late = static_cast<int32_t>(start - due);
+    collectStats->record(micros() - startUS, late > 0 ? late : 0);
+    due = start + COLLECT_INTERVAL_MS;
 
     // Run any available tasks until collection is ready.
-    while (millis() - start < 1000) {
+    for (uint32_t elapsed = millis() - start; elapsed < COLLECT_INTERVAL_MS; elapsed = millis() - start) {
         if (!c1Queue.runNextTask()) {
-            delay(10);
+            c1Queue.idle(std::min<uint32_t>(COLLECT_INTERVAL_MS - elapsed, IDLE_MAX_MS));
         }
 
         rp2040.wdt_reset();
@@ -228,7 +258,7 @@ void handleButtonPress() {
 
     stableState = reading;
     if (stableState == HIGH) {
-        c0Queue.add(addDeviceFromButton, 6);
+        c0Queue.add(addDeviceFromButton, 6, "addDeviceFromButton");
     }
 }
 
@@ -0,0 +1,173 @@
+//
+// Created by Nicholas Wiersma on 2026/03/02.
+//
+
+#ifndef FIRMWARE_METER_H
+#define FIRMWARE_METER_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+// meterReading is a decoded sample from a meter.
+struct meterReading {
+    float volts;
+    float amps;
+    float pf;
+    float hz;
+    float importKWh; // NaN when the meter has no counter.
+    float exportKWh;
+};
+
+// registerField is a value in a meter's input register map.
+struct registerField {
+    uint16_t addr;
+    uint8_t  count;
+};
+
+// registerBlock is a contiguous range of input registers read in a single request.
+struct registerBlock {
+    uint16_t start;
+    uint16_t count;
+    uint16_t offset; // Position of the block in the read buffer.
+};
+
+// A single Modbus read is limited to 125 registers.
+constexpr uint16_t maxBlockRegisters = 125;
+// Reading a few unused registers is cheaper than another request.
+constexpr uint16_t maxBlockGap = 8;
+// Size of the collector's read buffer for a single meter.
+constexpr uint16_t maxMeterRegisters = 64;
+
+// The register map helpers below run at compile time. Fields must be sorted by address.
+
+template<size_t N>
+constexpr size_t countBlocks(const std::array<registerField, N> &fields) {
+    size_t   n = 0;
+    uint16_t start = 0;
+    uint16_t end = 0;
+    for (size_t i = 0; i < N; i++) {
+        const uint16_t fieldEnd = fields[i].addr + fields[i].count;
+        if (n == 0 || fields[i].addr > end + maxBlockGap || fieldEnd - start > maxBlockRegisters) {
+            n++;
+            start = fields[i].addr;
+        }
+        end = fieldEnd;
+    }
+    return n;
+}
+
+template<size_t M, size_t N>
+constexpr std::array<registerBlock, M> makeBlocks(const std::array<registerField, N> &fields) {
+    std::array<registerBlock, M> blocks{};
+    size_t                       n = 0;
+    uint16_t                     offset = 0;
+    for (size_t i = 0; i < N; i++) {
+        const uint16_t fieldEnd = fields[i].addr + fields[i].count;
+        if (n == 0) {
+            blocks[n++] = registerBlock{fields[i].addr, fields[i].count, 0};
+            continue;
+        }
+        registerBlock &b = blocks[n - 1];
+        if (fields[i].addr > b.start + b.count + maxBlockGap || fieldEnd - b.start > maxBlockRegisters) {
+            offset += b.count;
+            blocks[n++] = registerBlock{fields[i].addr, fields[i].count, offset};
+            continue;
+        }
+        b.count = fieldEnd - b.start;
+    }
+    return blocks;
+}
+
+template<size_t M>
+constexpr uint16_t bufferSize(const std::array<registerBlock, M> &blocks) {
+    return blocks[M - 1].offset + blocks[M - 1].count;
+}
+
+template<size_t M>
+constexpr uint16_t bufferOffset(const std::array<registerBlock, M> &blocks, const uint16_t addr) {
+    for (size_t i = 0; i < M; i++) {
+        if (addr >= blocks[i].start && addr < blocks[i].start + blocks[i].count) {
+            return blocks[i].offset + (addr - blocks[i].start);
+        }
+    }
+    return UINT16_MAX;
+}
+
+inline float float_abcd(uint16_t hi, uint16_t lo) {
+    float    f;
+    uint32_t i;
+
+    i = ((uint32_t) hi << 16) + lo;
+    memcpy(&f, &i, sizeof(float));
+
+    return f;
+}
+
+// floatAt decodes the big endian float at addr from a meter's read buffer.
+template<typename Meter, uint16_t Addr>
+float floatAt(const uint16_t *regs) {
+    constexpr uint16_t off = bufferOffset(Meter::blocks, Addr);
+    static_assert(off != UINT16_MAX, "register is not in a read block");
+
+    return float_abcd(regs[off], regs[off + 1]);
+}
+
+// busSpeed maps a baud rate to the value a meter expects in its baud rate register.
+struct busSpeed {
+    uint32_t baud;
+    uint16_t code;
+};
+
+// SPM01 single phase meter.
+struct spm01 {
+    static constexpr std::array<registerField, 6> fields = {{
+        {0x4E20, 2}, // Voltage.
+        {0x4E22, 2}, // Current.
+        {0x4E26, 2}, // Power factor.
+        {0x4E28, 2}, // Frequency.
+        {0x4E30, 2}, // Non-resettable import energy.
+        {0x4E32, 2}, // Non-resettable export energy.
+    }};
+    static constexpr auto     blocks = makeBlocks<countBlocks(fields)>(fields);
+    static constexpr uint16_t registers = bufferSize(blocks);
+
+    // Supported baud rates, fastest first.
+    static constexpr uint16_t                baudRegister = 0x1771;
+    static constexpr std::array<busSpeed, 3> speeds = {{
+        {38400, 5},
+        {19200, 4},
+        {9600, 3},
+    }};
+
+    static void decode(const uint16_t *regs, meterReading &r) {
+        r.volts = floatAt<spm01, 0x4E20>(regs);
+        r.amps = floatAt<spm01, 0x4E22>(regs);
+        r.pf = floatAt<spm01, 0x4E26>(regs);
+        r.hz = floatAt<spm01, 0x4E28>(regs);
+        r.importKWh = floatAt<spm01, 0x4E30>(regs);
+        r.exportKWh = floatAt<spm01, 0x4E32>(regs);
+    }
+};
+
+static_assert(spm01::blocks.size() == 1, "SPM01 should be read in a single request");
+static_assert(spm01::registers == 20, "unexpected SPM01 register span");
+
+// meterDriver is how the collector talks to a meter model.
+struct meterDriver {
+    const registerBlock *blocks;
+    uint8_t              blockCount;
+    uint16_t             registers;
+    void (*             decode)(const uint16_t *regs, meterReading &r);
+};
+
+template<typename Meter>
+constexpr meterDriver makeDriver() {
+    static_assert(Meter::registers <= maxMeterRegisters, "meter reads too many registers");
+
+    return meterDriver{Meter::blocks.data(), Meter::blocks.size(), Meter::registers, Meter::decode};
+}
+
+inline constexpr meterDriver spm01Driver = makeDriver<spm01>();
+
+#endif //FIRMWARE_METER_H
@@ -13,6 +13,11 @@ struct promMetrics {
     std::atomic<uint32_t> modbus_last_run_avg_ms{0};
     std::atomic<uint32_t> datalog_io{0};
     std::atomic<uint32_t> datalog_cache_hit{0};
+    std::atomic<uint32_t> http_requests_total{0};
+    std::atomic<uint32_t> http_connections_total{0};
+    std::atomic<uint32_t> http_chunks_total{0};
+    std::atomic<uint64_t> http_chunk_bytes_total{0};
+    std::atomic<uint32_t> live_frames_total{0};
 };
 
 #endif //FIRMWARE_METRICS_H
@@ -20,7 +20,8 @@ const inline char *modbusErrStr[] PROGMEM = {
     "unexpected byte count",
     "unexpected address",
     "unexpected value",
-    "unexpected quantity"
+    "unexpected quantity",
+    "bus busy"
 };
 
 const inline char * PROGMEM modbusExcpStr[] = {
@@ -36,36 +37,198 @@ const inline char * PROGMEM modbusExcpStr[] = {
     "gateway target device failed to respond"
 };
 
-const char *modbusError(uint8_t err) {
-    if (err == MODBUS_RTU_MASTER_EXCEPTION_RESPONSE) {
-        return modbusExcpStr[modbus.getExceptionResponse()];
+const char *modbusError(const modbusBus &bus, uint8_t err) {
+    if (err == MODBUS_EXCEPTION_RESPONSE) {
+        const uint8_t code = bus.getExceptionResponse();
+        if (code >= 1 && code <= sizeof(modbusExcpStr) / sizeof(modbusExcpStr[0])) {
+            return modbusExcpStr[code - 1];
+        }
+        return modbusErrStr[err];
+    }
+    if (err >= sizeof(modbusErrStr) / sizeof(modbusErrStr[0])) {
+        return "unknown error";
     }
     return modbusErrStr[err];
 }
 
-void locateModbusDevice(uint16_t id) {
-    if (const uint8_t err = modbus.writeSingleHoldingRegister(id, 0x2710, 0x5055)) {
-        LOGE("Could not locate modbus device: %s", modbusError(err));
+bool isCorruptFrame(uint8_t err) {
+    switch (err) {
+        case MODBUS_FRAME_ERROR:
+        case MODBUS_CRC_ERROR:
+        case MODBUS_UNEXPECTED_ID:
+        case MODBUS_UNEXPECTED_FUNCTION_CODE:
+        case MODBUS_UNEXPECTED_RESPONSE_LENGTH:
+        case MODBUS_UNEXPECTED_BYTE_COUNT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const busSpeed *findBusSpeed(uint32_t baud) {
+    for (const auto &s: spm01::speeds) {
+        if (s.baud == baud) {
+            return &s;
+        }
     }
+    return nullptr;
 }
 
-void assignModbusAddress(uint16_t id) {
-    Serial1.begin(9600);
-    modbus.begin(9600);
+uint8_t readMeter(modbusBus &bus, const inputDevice *dev, meterReading &r) {
+    uint16_t regs[maxMeterRegisters];
+    for (uint8_t i = 0; i < dev->driver->blockCount; i++) {
+        const registerBlock &b = dev->driver->blocks[i];
+        if (const uint8_t err = bus.readInputRegisters(dev->addr, b.start, regs + b.offset, b.count)) {
+            return err;
+        }
+    }
+    dev->driver->decode(regs, r);
+    return 0;
+}
+
+void locateModbusDevice(uint8_t b, uint16_t id) {
+    if (const uint8_t err = buses[b].writeSingleHoldingRegister(id, 0x2710, 0x5055)) {
+        LOGE("Could not locate modbus device: %s", modbusError(buses[b], err));
+    }
+}
+
+void assignModbusAddress(uint8_t b, uint16_t id) {
+    modbusBus &     bus = buses[b];
+    const busSpeed *speed = findBusSpeed(bus.baud());
+    if (!speed) {
+        speed = &spm01::speeds[0];
+    }
+
+    bus.begin(9600);
 
     delay(100);
 
-    if (const uint8_t err = modbus.writeSingleHoldingRegister(247, 0x1771, 5)) {
-        LOGE("Could not set baudrate: %s", modbusError(err));
+    if (const uint8_t err = bus.writeSingleHoldingRegister(247, spm01::baudRegister, speed->code)) {
+        LOGE("Could not set baudrate: %s", modbusError(bus, err));
     }
 
-    Serial1.begin(RS485_BAUDRATE);
-    modbus.begin(RS485_BAUDRATE);
+    bus.begin(speed->baud);
 
     delay(100);
 
     uint16_t modbusAddress[] = {0x55AA, id};
-    if (const uint8_t err = modbus.writeMultipleHoldingRegisters(0, 0x7530, modbusAddress, 2)) {
-        LOGE("Could not write modbus address: %s", modbusError(err));
+    if (const uint8_t err = bus.writeMultipleHoldingRegisters(0, 0x7530, modbusAddress, 2)) {
+        LOGE("Could not write modbus address: %s", modbusError(bus, err));
+    }
+}
+
+// probeBus reads every enabled meter on a bus a number of times, returning the error percentage.
+uint32_t probeBus(uint8_t b, uint8_t rounds) {
+    uint32_t reads = 0;
+    uint32_t errs = 0;
+    for (uint8_t i = 0; i < rounds; i++) {
+        for (uint8_t d = 0; d < activeDeviceCount; d++) {
+            const inputDevice *dev = activeDevices[d];
+            if (dev->bus != b) {
+                continue;
+            }
+
+            meterReading r;
+            if (readMeter(buses[b], dev, r)) {
+                errs++;
+            }
+            reads++;
+
+            rp2040.wdt_reset();
+        }
     }
+    return reads > 0 ? errs * 100 / reads : 0;
+}
+
+// moveMeter switches a meter to a new speed. A meter that did not follow
+// an earlier change is tried at each of the other speeds.
+bool moveMeter(modbusBus &bus, uint8_t addr, const busSpeed &speed) {
+    const uint32_t baud = bus.baud();
+    if (!bus.writeSingleHoldingRegister(addr, spm01::baudRegister, speed.code)) {
+        return true;
+    }
+
+    for (const auto &s: spm01::speeds) {
+        if (s.baud == baud) {
+            continue;
+        }
+
+        bus.begin(s.baud);
+        if (!bus.writeSingleHoldingRegister(addr, spm01::baudRegister, speed.code)) {
+            bus.begin(baud);
+            return true;
+        }
+    }
+    bus.begin(baud);
+    return false;
+}
+
+void detectBusSpeed(uint8_t b) {
+    for (const auto &s: spm01::speeds) {
+        buses[b].begin(s.baud);
+        if (probeBus(b, 1) < 100) {
+            LOGI("Modbus: bus %u running at %u baud", b, s.baud);
+            return;
+        }
+    }
+
+    LOGE("Modbus: no meters responded on bus %u, using %u baud", b, RS485_BAUDRATE);
+    buses[b].begin(RS485_BAUDRATE);
+}
+
+void negotiateBusSpeed(uint8_t b, size_t from) {
+    modbusBus &bus = buses[b];
+
+    for (size_t i = from; i < spm01::speeds.size(); i++) {
+        const busSpeed &speed = spm01::speeds[i];
+
+        if (speed.baud != bus.baud()) {
+            // Meters reply to the change at their old speed, then switch.
+            for (uint8_t d = 0; d < activeDeviceCount; d++) {
+                const inputDevice *dev = activeDevices[d];
+                if (dev->bus != b) {
+                    continue;
+                }
+                if (!moveMeter(bus, dev->addr, speed)) {
+                    LOGE("Modbus: could not move device %d to %u baud", dev->addr, speed.baud);
+                }
+                rp2040.wdt_reset();
+            }
+            bus.begin(speed.baud);
+
+            delay(100);
+        }
+
+        const uint32_t errPct = probeBus(b, MODBUS_PROBE_ROUNDS);
+        if (errPct <= MODBUS_MAX_ERROR_PCT) {
+            LOGI("Modbus: bus %u running at %u baud with %u%% errors", b, speed.baud, errPct);
+            return;
+        }
+
+        bus.stats.fallbacks.fetch_add(1, std::memory_order_relaxed);
+        LOGE("Modbus: %u%% errors at %u baud on bus %u, falling back", errPct, speed.baud, b);
+    }
+}
+
+void checkBusErrors(uint8_t b, uint32_t reads, uint32_t corrupt) {
+    static uint8_t badPasses[MODBUS_BUSES] = {};
+
+    if (reads == 0 || corrupt * 100 <= reads * MODBUS_MAX_ERROR_PCT) {
+        badPasses[b] = 0;
+        return;
+    }
+    if (++badPasses[b] < MODBUS_FALLBACK_PASSES) {
+        return;
+    }
+    badPasses[b] = 0;
+
+    const busSpeed *speed = findBusSpeed(buses[b].baud());
+    const size_t    next = speed ? speed - spm01::speeds.data() + 1 : spm01::speeds.size();
+    if (next >= spm01::speeds.size()) {
+        // Already at the slowest speed, nothing to fall back to.
+        return;
+    }
+
+    LOGE("Modbus: too many corrupt frames at %u baud on bus %u", buses[b].baud(), b);
+    negotiateBusSpeed(b, next);
 }
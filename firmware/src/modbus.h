@@ -5,8 +5,13 @@
 #ifndef FIRMWARE_MODBUS_H
 #define FIRMWARE_MODBUS_H
 
-const char *modbusError(uint8_t err);
-void        locateModbusDevice(uint16_t id);
-void        assignModbusAddress(uint16_t id);
+const char *modbusError(const modbusBus &bus, uint8_t err);
+bool        isCorruptFrame(uint8_t err);
+uint8_t     readMeter(modbusBus &bus, const inputDevice *dev, meterReading &r);
+void        locateModbusDevice(uint8_t bus, uint16_t id);
+void        assignModbusAddress(uint8_t bus, uint16_t id);
+void        detectBusSpeed(uint8_t bus);
+void        negotiateBusSpeed(uint8_t bus, size_t from = 0);
+void        checkBusErrors(uint8_t bus, uint32_t reads, uint32_t corrupt);
 
 #endif //FIRMWARE_MODBUS_H
@@ -0,0 +1,70 @@
+//
+// Created by Nicholas Wiersma on 2026/03/21.
+//
+
+#ifndef FIRMWARE_QUEUE_H
+#define FIRMWARE_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+
+// spscQueue is a lock free ring for handing values from one core to the
+// other. Only one core may push and only the other may pop.
+template <typename T, uint32_t N>
+class spscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "queue size must be a power of two");
+
+public:
+    spscQueue() : _head(0), _tail(0), _highWater(0), _dropped(0) {
+    }
+
+    // push copies v into the queue, returning false when it is full.
+    bool push(const T &v) {
+        const uint32_t tail = _tail.load(std::memory_order_relaxed);
+        const uint32_t depth = tail - _head.load(std::memory_order_acquire);
+        if (depth >= N) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        _items[tail & (N - 1)] = v;
+        _tail.store(tail + 1, std::memory_order_release);
+
+        if (depth + 1 > _highWater.load(std::memory_order_relaxed)) {
+            _highWater.store(depth + 1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // pop copies the oldest value into v, returning false when empty.
+    bool pop(T &v) {
+        const uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        v = _items[head & (N - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t depth() const {
+        // Head first: the tail never falls behind it.
+        const uint32_t head = _head.load(std::memory_order_acquire);
+        return _tail.load(std::memory_order_acquire) - head;
+    }
+
+    uint32_t capacity() const { return N; }
+    uint32_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+    std::atomic<uint32_t> _highWater;
+    std::atomic<uint32_t> _dropped;
+
+    T _items[N];
+};
+
+#endif //FIRMWARE_QUEUE_H
@@ -0,0 +1,36 @@
+//
+// Created by Nicholas Wiersma on 2026/04/02.
+//
+
+#include "auramon.h"
+
+static bool rebootRequested = false;
+
+// rebootTask lets pending responses go out, then reboots once no
+// SD card operation is in flight.
+uint32_t rebootTask(void *param) {
+    (void) param;
+
+    static resumable r;
+
+    TASK_BEGIN(r);
+
+    TASK_SLEEP(r, 100);
+
+    // Grab the SD Card mutex to ensure we are not in a write when we reboot.
+    TASK_WAIT_UNTIL(r, mutex_try_enter(&sdMu, nullptr), 10);
+    rp2040.reboot();
+
+    TASK_END(r);
+
+    return 0;
+}
+
+// requestReboot schedules a reboot on core 0 without blocking the caller.
+void requestReboot() {
+    if (rebootRequested) {
+        return;
+    }
+    rebootRequested = true;
+    c0Queue.add(rebootTask, 9, "reboot");
+}
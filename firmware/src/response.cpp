@@ -0,0 +1,62 @@
+//
+// Created by Nicholas Wiersma on 2026/03/06.
+//
+
+#ifndef UNIT_TEST
+#include "auramon.h"
+#else
+#include "../test/stubs/TestAuraMon.h"
+#endif
+#include "response.h"
+#include "format.h"
+
+void responseWriter::write(const char *data, size_t len) {
+    if (_len + len > sizeof(_buf)) {
+        flush();
+    }
+    // Too big for one chunk, it is split over as many as it needs. The sink
+    // never gets more than a chunk at once.
+    while (len > sizeof(_buf)) {
+        memcpy(_buf, data, sizeof(_buf));
+        _len = sizeof(_buf);
+        flush();
+        data += sizeof(_buf);
+        len -= sizeof(_buf);
+    }
+    memcpy(_buf + _len, data, len);
+    _len += len;
+}
+
+void responseWriter::write(char c) {
+    if (_len == sizeof(_buf)) {
+        flush();
+    }
+    _buf[_len++] = c;
+}
+
+void responseWriter::writeFixed(double value, uint8_t precision) {
+    char buf[formatFixedSize];
+    write(buf, formatFixed(buf, value, precision));
+}
+
+char *responseWriter::buffer(size_t min, size_t *free) {
+    if (sizeof(_buf) - _len < min) {
+        flush();
+    }
+    *free = sizeof(_buf) - _len;
+    return _buf + _len;
+}
+
+void responseWriter::flush() {
+    if (_len == 0) {
+        return;
+    }
+    send(_buf, _len);
+    _len = 0;
+}
+
+void responseWriter::send(const char *data, size_t len) {
+    _sink(_ctx, data, len);
+    metrics.http_chunks_total.fetch_add(1, std::memory_order_relaxed);
+    metrics.http_chunk_bytes_total.fetch_add(len, std::memory_order_relaxed);
+}
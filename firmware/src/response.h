@@ -0,0 +1,52 @@
+//
+// Created by Nicholas Wiersma on 2026/03/06.
+//
+
+#ifndef FIRMWARE_RESPONSE_H
+#define FIRMWARE_RESPONSE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// A chunk fills one TCP segment: the 1460 byte MSS less the chunk size line and trailing CRLF.
+constexpr size_t responseChunkSize = 1460 - 8;
+
+// responseWriter gathers a streamed response into MSS sized chunks, so each
+// chunk goes out as one full TCP segment instead of one per row. The sink is
+// never handed more than responseChunkSize bytes at once.
+class responseWriter {
+public:
+    typedef void (*sinkFunction)(void *ctx, const char *data, size_t len);
+
+    responseWriter(sinkFunction sink, void *ctx) : _sink(sink), _ctx(ctx) {
+    }
+
+    void write(const char *data, size_t len);
+    void write(const char *str) { write(str, strlen(str)); }
+    void write(char c);
+    // writeFixed writes value with precision decimals, nothing if it is not finite.
+    void writeFixed(double value, uint8_t precision);
+    void writeUint(uint32_t value) { writeFixed(value, 0); }
+
+    // buffer returns the free space at the end of the buffer, flushing first
+    // when fewer than min bytes are free. Call commit with the bytes used.
+    char *buffer(size_t min, size_t *free);
+    void  commit(size_t n) { _len += n; }
+    // pending returns the bytes waiting in the buffer.
+    size_t pending() const { return _len; }
+
+    void flush();
+    // discard drops the buffered bytes without sending them.
+    void discard() { _len = 0; }
+
+private:
+    sinkFunction _sink;
+    void *       _ctx;
+    size_t       _len = 0;
+    char         _buf[responseChunkSize];
+
+    void send(const char *data, size_t len);
+};
+
+#endif // FIRMWARE_RESPONSE_H
@@ -0,0 +1,166 @@
+//
+// Created by Nicholas Wiersma on 2026/03/09.
+//
+
+#ifndef UNIT_TEST
+#include "auramon.h"
+#else
+#include "../test/stubs/TestAuraMon.h"
+#endif
+
+// The working scan is only touched on core 1.
+busScan scan;
+
+bool startBusScan(uint8_t bus) {
+    if (scan.state == scanState::Running) {
+        LOGE("Scan: already scanning bus %u", scan.bus);
+        return false;
+    }
+
+    scan = busScan();
+    scan.state = scanState::Running;
+    scan.bus = bus;
+    scan.next = 1;
+    scan.timeoutMs = MODBUS_SCAN_MAX_TIMEOUT_MS;
+    scan.startMs = millis();
+
+    LOGI("Scan: scanning bus %u", bus);
+    return true;
+}
+
+// probeAddress reports whether anything answered at addr. Exception
+// responses count, since only a device with that address would send one.
+uint8_t probeAddress(modbusBus &bus, uint8_t addr) {
+    uint16_t regs[2];
+    return bus.readInputRegisters(addr, spm01Driver.blocks[0].start, regs, 2);
+}
+
+void adaptTimeout(const modbusBus &bus) {
+    const uint32_t us = bus.responseUS();
+    if (us > scan.maxResponseUS) {
+        scan.maxResponseUS = us;
+    }
+
+    // Allow twice the slowest response seen so far.
+    uint32_t ms = scan.maxResponseUS * 2 / 1000 + 1;
+    if (ms < MODBUS_SCAN_MIN_TIMEOUT_MS) {
+        ms = MODBUS_SCAN_MIN_TIMEOUT_MS;
+    }
+    if (ms > MODBUS_SCAN_MAX_TIMEOUT_MS) {
+        ms = MODBUS_SCAN_MAX_TIMEOUT_MS;
+    }
+    scan.timeoutMs = ms;
+}
+
+bool isConfiguredLocked(uint8_t bus, uint8_t addr) {
+    for (const auto info: deviceInfos) {
+        if (info && info->bus == bus && info->addr == addr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// mergeScan adds newly found meters to free channels.
+void mergeScan() {
+    bool added = false;
+
+    mutex_enter_blocking(&deviceInfoMu);
+
+    for (uint16_t addr = 1; addr <= 247; addr++) {
+        if (!scan.isFound(addr) || isConfiguredLocked(scan.bus, addr)) {
+            continue;
+        }
+
+        const int channel = findAvailableChannelLocked();
+        if (channel < 0) {
+            LOGE("Scan: no free channel for device %u on bus %u", addr, scan.bus);
+            break;
+        }
+
+        auto info = new inputDeviceInfo(channel, addr);
+        info->enabled = true;
+        info->bus = scan.bus;
+        char nameBuf[24];
+        if (snprintf(nameBuf, sizeof(nameBuf), "Device %u", addr) > 0) {
+            info->name = strdup(nameBuf);
+        } else {
+            info->name = strdup("Device");
+        }
+        deviceInfos[channel] = info;
+        added = true;
+
+        LOGI("Scan: added device %u on bus %u", addr, scan.bus);
+    }
+    if (added) {
+        syncDeviceInfo();
+    }
+
+    mutex_exit(&deviceInfoMu);
+
+    if (!added) {
+        return;
+    }
+    // The SD card belongs to core 0.
+    if (!c0Commands.push({deviceActionType::Save, 0, 0, 0})) {
+        LOGE("Scan: could not ask for the config to be saved");
+        return;
+    }
+    c0Queue.notify();
+}
+
+void publishScan() {
+    if (!mutex_enter_block_until(&scanMu, 10)) {
+        return;
+    }
+    scanResult = scan;
+    mutex_exit(&scanMu);
+}
+
+uint32_t scanTask(void *param) {
+    (void) param;
+
+    if (scan.state != scanState::Running) {
+        return 500;
+    }
+
+    modbusBus &    bus = buses[scan.bus];
+    const uint32_t timeoutMS = bus.timeout();
+    const uint32_t start = millis();
+
+    // Probe for a short slice at a time so collection is not held up.
+    while (scan.next <= 247 && millis() - start < MODBUS_SCAN_SLICE_MS) {
+        const uint8_t addr = scan.next;
+
+        bus.setTimeout(scan.retried ? MODBUS_SCAN_MAX_TIMEOUT_MS : scan.timeoutMs);
+        const uint8_t err = probeAddress(bus, addr);
+        if (err == MODBUS_OK || err == MODBUS_EXCEPTION_RESPONSE) {
+            scan.setFound(addr);
+            adaptTimeout(bus);
+        } else if (err != MODBUS_RESPONSE_TIMEOUT && !scan.retried) {
+            // A partial or garbled reply may be a slow meter cut off
+            // by the short timeout. Try again with the longest one.
+            scan.retried = true;
+            continue;
+        }
+
+        scan.retried = false;
+        scan.next++;
+
+        rp2040.wdt_reset();
+    }
+
+    bus.setTimeout(timeoutMS);
+
+    if (scan.next > 247) {
+        scan.state = scanState::Done;
+        scan.tookMs = millis() - scan.startMs;
+        LOGI("Scan: found %u devices on bus %u in %ums", scan.foundCount, scan.bus, scan.tookMs);
+
+        mergeScan();
+    }
+
+    publishScan();
+
+    return 10;
+}
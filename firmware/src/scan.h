@@ -0,0 +1,39 @@
+//
+// Created by Nicholas Wiersma on 2026/03/09.
+//
+
+#ifndef FIRMWARE_SCAN_H
+#define FIRMWARE_SCAN_H
+
+#include <cstdint>
+
+enum class scanState : uint8_t { Idle = 0, Running, Done };
+
+// busScan is the progress and result of probing every address on a bus.
+struct busScan {
+    scanState state;
+    uint8_t   bus;
+    uint8_t   next;      // Next address to probe.
+    bool      retried;   // The current address has been probed again with a longer timeout.
+    uint8_t   timeoutMs; // Probe timeout, adapted to how fast meters respond.
+    uint32_t  maxResponseUS;
+    uint32_t  startMs;
+    uint32_t  tookMs;
+    uint8_t   foundCount;
+    uint8_t   found[32]; // Bitmap of responding addresses.
+
+    busScan() : state(scanState::Idle), bus(0), next(0), retried(false), timeoutMs(0), maxResponseUS(0),
+                startMs(0), tookMs(0), foundCount(0), found{} {
+    }
+
+    bool isFound(uint8_t addr) const { return found[addr >> 3] & (1 << (addr & 7)); }
+
+    void setFound(uint8_t addr) {
+        found[addr >> 3] |= 1 << (addr & 7);
+        foundCount++;
+    }
+};
+
+bool startBusScan(uint8_t bus);
+
+#endif //FIRMWARE_SCAN_H
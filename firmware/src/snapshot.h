@@ -0,0 +1,53 @@
+//
+// Created by Nicholas Wiersma on 2026/03/24.
+//
+
+#ifndef FIRMWARE_SNAPSHOT_H
+#define FIRMWARE_SNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+
+// snapshot hands the latest value from one core to the other without
+// locking. It is a sequence lock: the sequence is odd while a value is being
+// written and even once it is done, and a read is retried if the sequence
+// was odd or moved on while it was copying.
+template <typename T>
+class snapshot {
+public:
+    snapshot() : _seq(0), _buf{} {
+    }
+
+    // publish may only be called from one core.
+    void publish(const T &v) {
+        const uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _buf = v;
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    T read() const {
+        T v;
+        while (true) {
+            const uint32_t seq = _seq.load(std::memory_order_acquire);
+            if (seq & 1) {
+                continue;
+            }
+            v = _buf;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_seq.load(std::memory_order_relaxed) == seq) {
+                return v;
+            }
+        }
+    }
+
+    // version is the number of values published so far.
+    uint32_t version() const { return _seq.load(std::memory_order_acquire) / 2; }
+
+private:
+    std::atomic<uint32_t> _seq;
+    T                     _buf;
+};
+
+#endif //FIRMWARE_SNAPSHOT_H
@@ -2,31 +2,209 @@
 // Created by Nicholas Wiersma on 2025/10/20.
 //
 
+#ifndef UNIT_TEST
 #include "auramon.h"
+#else
+#include "../test/stubs/TestAuraMon.h"
+#endif
 #include "task.h"
 
-void taskQueue::add(taskFunction func, uint8_t priority, void *param) {
-    auto t = task{0, priority, func, param};
-    _tasks.push(t);
+#include <algorithm>
+
+static uint32_t millisClock() {
+    return millis();
+}
+
+// The clock of the queue running a task, per core.
+static taskClock runningClocks[2] = {};
+
+static uint8_t coreNum() {
+#ifndef UNIT_TEST
+    return get_core_num();
+#else
+    return 0;
+#endif
+}
+
+uint32_t taskNow() {
+    const taskClock clock = runningClocks[coreNum()];
+    return clock ? clock() : millis();
+}
+
+void taskStats::record(uint32_t us) {
+    runs.fetch_add(1, std::memory_order_relaxed);
+    runUS.fetch_add(us, std::memory_order_relaxed);
+    if (us > maxUS.load(std::memory_order_relaxed)) {
+        maxUS.store(us, std::memory_order_relaxed);
+    }
+}
+
+void taskStats::record(uint32_t us, uint32_t ms) {
+    record(us);
+
+    uint8_t b = 0;
+    while (b < taskLateBuckets - 1 && ms > taskLateBoundsMs[b]) {
+        b++;
+    }
+    late[b].fetch_add(1, std::memory_order_relaxed);
+    lateMs.fetch_add(ms, std::memory_order_relaxed);
+}
+
+taskQueue::taskQueue(taskClock clock) : _clock(clock ? clock : millisClock), _tasks{}, _count(0),
+                                        _statsCount(0), _busySinceUS(0), _notified(false) {
+}
+
+bool taskQueue::add(taskFunction func, uint8_t priority, const char *name, void *param) {
+    return addTask(func, priority, name, param, false);
+}
+
+bool taskQueue::addOnNotify(taskFunction func, uint8_t priority, const char *name, void *param) {
+    return addTask(func, priority, name, param, true);
+}
+
+bool taskQueue::addTask(taskFunction func, uint8_t priority, const char *name, void *param, bool onNotify) {
+    if (_count == maxTasks) {
+        LOGE("Task queue full, dropping task %s", name);
+        return false;
+    }
+
+    const taskStats *s = stats(name);
+    const uint8_t    slot = s ? s - _stats : 0xFF;
+    push(task{_clock(), priority, slot, onNotify, func, param});
+    return true;
+}
+
+void taskQueue::notify() {
+    _notified.store(true, std::memory_order_release);
+#ifndef UNIT_TEST
+    __sev();
+#endif
+}
+
+// wakeNotified makes every onNotify task due now.
+void taskQueue::wakeNotified() {
+    const uint32_t now = _clock();
+    const uint8_t  n = _count;
+    task           tasks[maxTasks];
+    memcpy(tasks, _tasks, sizeof(task) * n);
+
+    _count = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        if (tasks[i].onNotify) {
+            tasks[i].nextRun = now;
+        }
+        push(tasks[i]);
+    }
 }
 
 bool taskQueue::runNextTask() {
-    if (_tasks.empty()) {
+    if (_notified.exchange(false, std::memory_order_acquire)) {
+        wakeNotified();
+    }
+    if (_count == 0) {
         return false;
     }
 
     // Check if the next task is ready to run.
-    auto t = _tasks.top();
-    if (millis() < _tasks.top().nextRun) {
+    const uint32_t now = _clock();
+    if (static_cast<int32_t>(now - _tasks[0].nextRun) < 0) {
         // The task is not ready to run yet.
         return false;
     }
-    _tasks.pop();
+    task t = _tasks[0];
+    pop();
+
+    taskClock &running = runningClocks[coreNum()];
+    running = _clock;
+    const uint32_t start = micros();
+    auto           nextRun = t.func(t.param);
+    running = nullptr;
+    if (t.stats != 0xFF) {
+        _stats[t.stats].record(micros() - start, now - t.nextRun);
+    }
 
-    auto nextRun = t.func(t.param);
     if (nextRun > 0) {
-        t.nextRun = nextRun + millis();
-        _tasks.push(t);
+        t.nextRun = nextRun + _clock();
+        push(t);
     }
     return true;
 }
+
+uint32_t taskQueue::nextDelay() const {
+    if (_count == 0) {
+        return UINT32_MAX;
+    }
+    const int32_t d = static_cast<int32_t>(_tasks[0].nextRun - _clock());
+    return d > 0 ? d : 0;
+}
+
+void taskQueue::idle(uint32_t maxMs) {
+    const uint32_t ms = std::min(maxMs, nextDelay());
+    if (ms == 0 || _notified.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    const uint32_t start = micros();
+    if (_busySinceUS != 0) {
+        _load.busyUS.fetch_add(start - _busySinceUS, std::memory_order_relaxed);
+    }
+
+#ifndef UNIT_TEST
+    // Sleep until the alarm, an interrupt or a SEV from the other core.
+    best_effort_wfe_or_timeout(make_timeout_time_ms(ms));
+#else
+    delay(ms);
+#endif
+
+    _busySinceUS = micros();
+    _load.idleUS.fetch_add(_busySinceUS - start, std::memory_order_relaxed);
+}
+
+taskStats *taskQueue::stats(const char *name) {
+    const uint8_t n = _statsCount.load(std::memory_order_relaxed);
+    for (uint8_t i = 0; i < n; i++) {
+        if (strcmp(_stats[i].name, name) == 0) {
+            return &_stats[i];
+        }
+    }
+    if (n == maxTasks + 2) {
+        return nullptr;
+    }
+
+    _stats[n].name = name;
+    _statsCount.store(n + 1, std::memory_order_release);
+    return &_stats[n];
+}
+
+void taskQueue::push(const task &t) {
+    uint8_t i = _count++;
+    while (i > 0) {
+        const uint8_t parent = (i - 1) / 2;
+        if (!t.runsBefore(_tasks[parent])) {
+            break;
+        }
+        _tasks[i] = _tasks[parent];
+        i = parent;
+    }
+    _tasks[i] = t;
+}
+
+void taskQueue::pop() {
+    const task last = _tasks[--_count];
+    uint8_t    i = 0;
+    while (true) {
+        uint8_t child = 2 * i + 1;
+        if (child >= _count) {
+            break;
+        }
+        if (child + 1 < _count && _tasks[child + 1].runsBefore(_tasks[child])) {
+            child++;
+        }
+        if (!_tasks[child].runsBefore(last)) {
+            break;
+        }
+        _tasks[i] = _tasks[child];
+        i = child;
+    }
+    _tasks[i] = last;
+}
@@ -5,36 +5,132 @@
 #ifndef FIRMWARE_TASK_H
 #define FIRMWARE_TASK_H
 
+#include <atomic>
 #include <cstdint>
-#include <functional>
-#include <queue>
 
-typedef std::function<uint32_t(void *param)> taskFunction;
+// A task returns the milliseconds until it should run again, or 0 to stop.
+typedef uint32_t (*taskFunction)(void *param);
+typedef uint32_t (*taskClock)();
+
+// Upper bounds in ms of the task lateness histogram, the last bucket is +Inf.
+constexpr uint8_t  taskLateBuckets = 7;
+constexpr uint32_t taskLateBoundsMs[taskLateBuckets - 1] = {1, 5, 10, 50, 100, 500};
+
+// taskStats is written by the core running the task and read by core 0 for /metrics.
+struct taskStats {
+    const char *          name = nullptr;
+    std::atomic<uint32_t> runs{0};
+    std::atomic<uint64_t> runUS{0};
+    std::atomic<uint32_t> maxUS{0};
+    std::atomic<uint64_t> lateMs{0};
+    std::atomic<uint32_t> late[taskLateBuckets] = {};
+
+    void record(uint32_t us);
+    void record(uint32_t us, uint32_t lateMs);
+};
+
+// coreLoad splits a core's time between work and waiting for work.
+struct coreLoad {
+    std::atomic<uint64_t> busyUS{0};
+    std::atomic<uint64_t> idleUS{0};
+};
+
+// resumable holds where a resumable task is up to. Such a task returns to
+// the scheduler while it waits and carries on from the same point next run,
+// so waiting never blocks the rest of the core. Locals do not survive a
+// yield, keep state in statics.
+//
+//   uint32_t myTask(void *param) {
+//       static resumable r;
+//       TASK_BEGIN(r);
+//       startSomething();
+//       TASK_WAIT_UNTIL(r, isDone(), 10);
+//       TASK_END(r);
+//       return 1000;
+//   }
+struct resumable {
+    uint16_t line = 0;
+    uint32_t since = 0; // taskNow() when the current wait started.
+};
+
+// taskNow is the clock of the queue running a task on this core, or
+// millis() outside of a task.
+uint32_t taskNow();
+
+#define TASK_BEGIN(r) switch ((r).line) { case 0:
+#define TASK_YIELD(r, ms) do { (r).line = __LINE__; return (ms); case __LINE__:; } while (0)
+#define TASK_WAIT_UNTIL(r, cond, ms) while (!(cond)) { TASK_YIELD(r, ms); }
+#define TASK_SLEEP(r, ms) do { (r).since = taskNow(); TASK_WAIT_UNTIL(r, taskNow() - (r).since >= (ms), (ms)); } while (0)
+#define TASK_RESTART(r, ms) do { (r).line = 0; return (ms); } while (0)
+#define TASK_END(r) } (r).line = 0
 
 struct task {
     uint32_t     nextRun;
     uint8_t      priority;
+    uint8_t      stats;
+    bool         onNotify; // Run as soon as the queue is notified.
     taskFunction func;
     void *       param;
 
-    bool operator<(const task &o) const {
-        if (nextRun > o.nextRun) {
-            return true;
-        }
-        if (nextRun == o.nextRun) {
-            return priority < o.priority;
+    // Deadlines are compared by their difference, so they keep
+    // working when millis() rolls over.
+    bool runsBefore(const task &o) const {
+        const int32_t d = static_cast<int32_t>(nextRun - o.nextRun);
+        if (d != 0) {
+            return d < 0;
         }
-        return false;
+        return priority > o.priority;
     }
 };
 
+// taskQueue is a fixed size binary heap of tasks ordered by deadline,
+// then priority. It never allocates.
 class taskQueue {
 public:
-    void add(taskFunction func, uint8_t priority, void *param = nullptr);
-    bool runNextTask();
+    static constexpr uint8_t maxTasks = 16;
+
+    // clock defaults to millis().
+    explicit taskQueue(taskClock clock = nullptr);
+
+    bool    add(taskFunction func, uint8_t priority, const char *name, void *param = nullptr);
+    // addOnNotify adds a task that also runs whenever the queue is notified,
+    // for tasks that drain a queue filled by the other core.
+    bool    addOnNotify(taskFunction func, uint8_t priority, const char *name, void *param = nullptr);
+    bool    runNextTask();
+    uint8_t size() const { return _count; }
+
+    // notify wakes the queue's core and makes its onNotify tasks due.
+    // Safe to call from the other core.
+    void notify();
+
+    // idle sleeps until the next task is due, at most maxMs, accounting the
+    // time as idle. Any interrupt or event from the other core ends it early.
+    void idle(uint32_t maxMs);
+    // nextDelay is the milliseconds until the next task is due.
+    uint32_t nextDelay() const;
+
+    // stats returns the stats for name, claiming a free slot the first time.
+    // Work done outside the queue, like collection, can be recorded there too.
+    taskStats *      stats(const char *name);
+    uint8_t          statsCount() const { return _statsCount.load(std::memory_order_acquire); }
+    const taskStats &statsAt(uint8_t i) const { return _stats[i]; }
+    const coreLoad & load() const { return _load; }
 
 private:
-    std::priority_queue<task> _tasks;
+    taskClock _clock;
+    task      _tasks[maxTasks];
+    uint8_t   _count;
+
+    taskStats            _stats[maxTasks + 2];
+    std::atomic<uint8_t> _statsCount;
+    coreLoad             _load;
+    uint32_t             _busySinceUS;
+    std::atomic<bool>    _notified;
+
+    bool addTask(taskFunction func, uint8_t priority, const char *name, void *param, bool onNotify);
+    void wakeNotified();
+    void push(const task &t);
+    void pop();
 };
 
 
@@ -50,75 +50,74 @@ void timestamp_ntoh(ntp_timestamp_t *t) {
 uint32_t timeSync(void *param) {
     (void) param;
 
-    static uint8_t srvIdx = 0;
-    WiFiUDP        udp;
-
-    if (millis() > 3628800000UL) {
-        // The millisecond monotonic clock will roll over every 49 days.
-        // Restart every 42 days to be safe.
-        LOGI("timeSync: Restarting to reset monotonic clock");
-        rp2040.reboot();
-    }
+    static resumable r;
+    static uint8_t   srvIdx = 0;
+    static WiFiUDP   udp;
+    static IPAddress srvIP;
+    static uint32_t  sentTS;
+
+    const uint32_t retryMS = rtcRunning ? 60 * 1000 : 5 * 1000;
+
+    TASK_BEGIN(r);
 
     if (!eth.isLinked() || !eth.connected()) {
         // Try again when ethernet is connected.
-        return rtcRunning ? 60 : 5;
+        TASK_RESTART(r, retryMS);
     }
 
-    String    srv = ntpSrvs[srvIdx++ % sizeof(ntpSrvs)];
-    IPAddress srvIP;
-    if (!eth.hostByName(srv.c_str(), srvIP)) {
-        return rtcRunning ? 60 : 5;
+    if (!eth.hostByName(ntpSrvs[srvIdx++ % (sizeof(ntpSrvs) / sizeof(ntpSrvs[0]))].c_str(), srvIP, 1000)) {
+        TASK_RESTART(r, retryMS);
     }
 
-    uint32_t        sentTS = millis();
-    ntp_timestamp_t origTS = {sentTS / 1000, sentTS % 1000};
-    ntpPacket       pkt;
-    pkt.originateTS = origTS;
-
-    udp.begin(ntpPort);
-    udp.beginPacket(srvIP, 123);
-    udp.write(reinterpret_cast<uint8_t *>(&pkt), sizeof(ntpPacket)); // send an NTP packet to a time server
-    udp.endPacket();
-
-    // Wait for the NTP reply.
-    while (!udp.parsePacket()) {
-        if (millis() - sentTS > (rtcRunning ? 3000 : 10000)) {
-            udp.stop();
-            return rtcRunning ? 60 : 5;
-        }
+    {
+        sentTS = millis();
+        ntpPacket pkt;
+        pkt.originateTS = {sentTS / 1000, sentTS % 1000};
+
+        udp.begin(ntpPort);
+        udp.beginPacket(srvIP, 123);
+        udp.write(reinterpret_cast<uint8_t *>(&pkt), sizeof(ntpPacket)); // send an NTP packet to a time server
+        udp.endPacket();
     }
 
-    uint32_t recvTS = millis();
-    size_t   pktSize = udp.read(reinterpret_cast<uint8_t *>(&pkt), sizeof(ntpPacket));
-    udp.stop();
+    // Wait for the NTP reply without holding up the web server.
+    TASK_WAIT_UNTIL(r, udp.parsePacket() || millis() - sentTS > (rtcRunning ? 3000 : 10000), 5);
 
-    if (pktSize < sizeof(ntpPacket)) {
-        return rtcRunning ? 60 : 5;
-    }
-    if (pkt.stratum == 0) {
-        LOGE("timeSync: Time server sent kiss-o-death packet: code=%c%c%c%c, ip=%s",
-             pkt.refClockIdent[0], pkt.refClockIdent[1], pkt.refClockIdent[2], pkt.refClockIdent[3],
-             srvIP.toString().c_str()
-        );
-        return rtcRunning ? 60 : 15;
-    }
+    {
+        const uint32_t recvTS = millis();
+        ntpPacket      pkt;
+        const size_t   pktSize = udp.available() ? udp.read(reinterpret_cast<uint8_t *>(&pkt), sizeof(ntpPacket)) : 0;
+        udp.stop();
+
+        if (pktSize < sizeof(ntpPacket)) {
+            TASK_RESTART(r, retryMS);
+        }
+        if (pkt.stratum == 0) {
+            LOGE("timeSync: Time server sent kiss-o-death packet: code=%c%c%c%c, ip=%s",
+                 pkt.refClockIdent[0], pkt.refClockIdent[1], pkt.refClockIdent[2], pkt.refClockIdent[3],
+                 srvIP.toString().c_str()
+            );
+            TASK_RESTART(r, rtcRunning ? 60 * 1000 : 15 * 1000);
+        }
+
+        timestamp_ntoh(&pkt.transmitTS);
+        pkt.transmitTS.fraction /= 4294967UL; // Convert from fraction to ms.
+        uint32_t       dur = recvTS - sentTS;
+        struct timeval tv;
+        tv.tv_sec = (pkt.transmitTS.seconds + (pkt.transmitTS.fraction + dur / 2) / 1000) - 2208988800UL;
+        tv.tv_usec = (pkt.transmitTS.fraction + dur / 2) % 1000;
+        settimeofday(&tv, nullptr);
+
+        rtc.adjust(tv.tv_sec);
+        if (!rtcRunning) {
+            rtc.start();
+            rtcRunning = true;
+        }
 
-    timestamp_ntoh(&pkt.transmitTS);
-    pkt.transmitTS.fraction /= 4294967UL; // Convert from fraction to ms.
-    uint32_t       dur = recvTS - sentTS;
-    struct timeval tv;
-    tv.tv_sec = (pkt.transmitTS.seconds + (pkt.transmitTS.fraction + dur / 2) / 1000) - 2208988800UL;
-    tv.tv_usec = (pkt.transmitTS.fraction + dur / 2) % 1000;
-    settimeofday(&tv, nullptr);
-
-    rtc.adjust(tv.tv_sec);
-    if (!rtcRunning) {
-        rtc.start();
-        rtcRunning = true;
+        LOGI("timeSync: RTC adjusted to Unix time %d", tv.tv_sec);
     }
 
-    LOGI("timeSync: RTC adjusted to Unix time %d", tv.tv_sec);
+    TASK_END(r);
 
     return 3600 * 1000;
 }
@@ -4,25 +4,66 @@
 
 #pragma once
 
+#include <cmath>
+
+#define MAX_DEVICES 15
+
 #include "TestPlatform.h"
 #include "TestLWIP.h"
 #include "TestSdFat.h"
+#include "TestSerial.h"
 #include "../../src/device.h"
 #include "../../src/ethernet.h"
+#include "../../src/bus.h"
 #include "../../src/metrics.h"
+#include "../../src/snapshot.h"
+#include "../../src/queue.h"
+#include "../../src/task.h"
+#include "../../src/scan.h"
 
 // Mock the constants and globals needed
 #define DATA_LOG_PATH "aura-mon/data.log"
+#define DATA_LOG_OLD_PATH "aura-mon/data.old"
+#define DATA_LOG_NEW_PATH "aura-mon/data.new"
 #define CONFIG_LOG_PATH "aura-mon/config.json"
 #define MS_PER_HOUR 3600000UL
+#define METER_MAX_WATTS 25000.0
 
 // Mock logging macros
 #define LOGD(...)
 #define LOGE(...)
+#define LOGI(...)
 
-#define MAX_DEVICES 15
+#define MODBUS_BUSES 1
+#define MODBUS_SCAN_MIN_TIMEOUT_MS 4
+#define MODBUS_SCAN_MAX_TIMEOUT_MS 30
+#define MODBUS_SCAN_SLICE_MS 20
+#define COMMAND_QUEUE_SIZE 8
 inline mutex_t deviceInfoMu;
 inline inputDeviceInfo *deviceInfos[MAX_DEVICES] = {};
+inline mutex_t          scanMu;
+inline busScan          scanResult;
+inline HardwareSerial   busSerial;
+inline modbusBus        buses[MODBUS_BUSES] = {{busSerial, -1}};
+inline taskQueue        c0Queue;
+
+inline spscQueue<deviceActionRequest, COMMAND_QUEUE_SIZE> c0Commands;
+
+inline int findAvailableChannelLocked() {
+    for (uint8_t i = 0; i < MAX_DEVICES; i++) {
+        if (deviceInfos[i] == nullptr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+inline void syncDeviceInfo() {
+}
+
+uint32_t scanTask(void *param);
+inline channelState     channels;
+inline snapshot<liveData> live;
 
 inline NetworkConfig netCfg;
 
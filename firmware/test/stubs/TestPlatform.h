@@ -68,6 +68,7 @@ struct MockRP2040 {
     void reset() { rebootCalled = false; }
 
     void reboot() { rebootCalled = true; }
+    void wdt_reset() {}
     void memcpyDMA(void *dst, const void *src, size_t sz) { std::memcpy(dst, src, sz); }
 };
 
@@ -84,6 +85,11 @@ inline bool mutex_enter_timeout_ms(mutex_t *mtx, uint32_t timeout) {
     (void) timeout;
     return true;
 }
+inline bool mutex_enter_block_until(mutex_t *mtx, uint32_t until) {
+    (void) mtx;
+    (void) until;
+    return true;
+}
 
 // Mock file operations flags
 #define O_RDONLY 0x01
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <cstdint>
+#include <map>
 #include <string>
 
 #include "TestPlatform.h"
@@ -16,8 +17,9 @@ public:
     std::vector<uint8_t> data;
     uint32_t position;
     bool open;
+    std::vector<uint8_t>* backing; // Written back on flush and close, if set.
 
-    FsFile() : position(0), open(false) {}
+    FsFile() : position(0), open(false), backing(nullptr) {}
 
     bool isOpen() const { return open; }
 
@@ -83,18 +85,26 @@ public:
         return 1;
     }
 
-    bool flush() { return true; }
+    bool flush() {
+        if (backing) *backing = data;
+        return true;
+    }
 
     void close() {
+        flush();
         open = false;
     }
 };
 
-// Simple file system stub
+// Simple file system stub. The first path opened shares file, any
+// other path is kept in others.
 class MockSD {
 public:
     FsFile* file;
+    std::string path;
     std::vector<std::string> directories;
+    std::vector<uint8_t> moved; // Contents of the last renamed file.
+    std::map<std::string, std::vector<uint8_t>> others;
     bool fileExists;
 
     MockSD() : file(nullptr), fileExists(false) {}
@@ -103,8 +113,11 @@ public:
         if (file) delete file;
     }
 
-    bool exists(const char* path) {
-        return fileExists;
+    bool exists(const char* p) {
+        if (others.count(p)) {
+            return true;
+        }
+        return fileExists && (path.empty() || path == p);
     }
 
     bool mkdir(const char* path) {
@@ -112,7 +125,13 @@ public:
         return true;
     }
 
-    bool remove(const char* path) {
+    bool remove(const char* p) {
+        if (others.erase(p)) {
+            return true;
+        }
+        if (path != p) {
+            return false;
+        }
         if (file) {
             file->data.clear();
             file->open = false;
@@ -121,7 +140,43 @@ public:
         return true;
     }
 
-    FsFile open(const char* path, int mode) {
+    bool rename(const char* from, const char* to) {
+        if (exists(to)) {
+            return false;
+        }
+        if (auto it = others.find(from); it != others.end()) {
+            if (path == to) {
+                if (!file) file = new FsFile();
+                file->data = it->second;
+                fileExists = true;
+            } else {
+                others[to] = it->second;
+            }
+            others.erase(from);
+            return true;
+        }
+        if (path != from) {
+            return false;
+        }
+        if (file) {
+            moved = file->data;
+            file->data.clear();
+        }
+        others[to] = moved;
+        fileExists = false;
+        return true;
+    }
+
+    FsFile open(const char* p, int mode) {
+        if (others.count(p) || (file && !path.empty() && path != p)) {
+            FsFile f;
+            f.backing = &others[p];
+            if (mode & O_TRUNC) f.backing->clear();
+            f.data = *f.backing;
+            f.open = true;
+            return f;
+        }
+        path = p;
         if (!file) {
             file = new FsFile();
         }
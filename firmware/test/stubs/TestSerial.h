@@ -0,0 +1,86 @@
+//
+// Serial and GPIO mocks for native testing
+//
+
+#pragma once
+
+#ifdef UNIT_TEST
+
+#include <stdint.h>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#define LOW 0
+#define HIGH 1
+#define OUTPUT 1
+
+inline unsigned long mockMicros = 0;
+
+inline unsigned long micros() {
+    mockMicros += 100;
+    return mockMicros;
+}
+
+inline void delayMicroseconds(unsigned int us) { mockMicros += us; }
+inline void delay(unsigned long ms) { mockMicros += ms * 1000; }
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    (void) pin;
+    (void) mode;
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t val) {
+    (void) pin;
+    (void) val;
+}
+
+class HardwareSerial {
+public:
+    uint32_t             baud = 0;
+    std::vector<uint8_t> written;
+    std::deque<uint8_t>  rx;
+    std::vector<uint8_t> response; // Queued for reading after the next write.
+    uint32_t             replyUS = 0; // Added to micros() before the first byte of the reply is read.
+
+    // Called for every write, to answer each request differently.
+    void (*onWrite)(HardwareSerial &serial, const uint8_t *buf, size_t len) = nullptr;
+
+    void begin(unsigned long b) { baud = b; }
+
+    int available() { return static_cast<int>(rx.size()); }
+
+    int read() {
+        if (rx.empty()) {
+            return -1;
+        }
+        mockMicros += replyUS;
+        replyUS = 0;
+        const uint8_t c = rx.front();
+        rx.pop_front();
+        return c;
+    }
+
+    size_t write(const uint8_t *buf, size_t len) {
+        written.insert(written.end(), buf, buf + len);
+        rx.insert(rx.end(), response.begin(), response.end());
+        response.clear();
+        if (onWrite) {
+            onWrite(*this, buf, len);
+        }
+        return len;
+    }
+
+    void flush() {
+    }
+
+    void reset() {
+        written.clear();
+        rx.clear();
+        response.clear();
+        replyUS = 0;
+        onWrite = nullptr;
+    }
+};
+
+#endif // UNIT_TEST
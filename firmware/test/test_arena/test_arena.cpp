@@ -0,0 +1,112 @@
+//
+// Unit tests for the request arena
+//
+
+#include <unity.h>
+#include <cstring>
+#include "../../src/arena.h"
+
+alignas(arenaAlign) uint8_t buf[1024];
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+bool inBuf(const void *p) {
+    return p >= buf && p < buf + sizeof(buf);
+}
+
+void test_arena_rewinds() {
+    arena a(buf, sizeof(buf));
+
+    void *p = a.allocate(10);
+    void *q = a.allocate(100);
+    TEST_ASSERT_TRUE(inBuf(p));
+    TEST_ASSERT_TRUE(inBuf(q));
+    TEST_ASSERT_TRUE(p != q);
+    TEST_ASSERT_EQUAL(0, reinterpret_cast<uintptr_t>(p) % arenaAlign);
+    TEST_ASSERT_EQUAL(0, reinterpret_cast<uintptr_t>(q) % arenaAlign);
+
+    // Given back out of order, the buffer is whole again once both are.
+    a.deallocate(p);
+    TEST_ASSERT_TRUE(a.used() > 0);
+    a.deallocate(q);
+    TEST_ASSERT_EQUAL(0, a.used());
+
+    TEST_ASSERT_TRUE(a.allocate(10) == p);
+    TEST_ASSERT_EQUAL(0, a.overflows());
+}
+
+void test_arena_last_block_given_back() {
+    arena a(buf, sizeof(buf));
+
+    void *       p = a.allocate(10);
+    const size_t used = a.used();
+    void *       q = a.allocate(100);
+    a.deallocate(q);
+    TEST_ASSERT_EQUAL(used, a.used());
+    a.deallocate(p);
+}
+
+void test_arena_overflows_to_heap() {
+    arena a(buf, sizeof(buf));
+
+    void *p = a.allocate(sizeof(buf) - 2 * arenaAlign);
+    void *q = a.allocate(64);
+    TEST_ASSERT_TRUE(inBuf(p));
+    TEST_ASSERT_FALSE(inBuf(q));
+    TEST_ASSERT_EQUAL(1, a.overflows());
+    TEST_ASSERT_EQUAL(sizeof(buf) - arenaAlign, a.peak());
+
+    a.deallocate(q);
+    a.deallocate(p);
+    TEST_ASSERT_EQUAL(0, a.used());
+}
+
+void test_arena_reallocate() {
+    arena a(buf, sizeof(buf));
+
+    // The newest block grows in place.
+    auto p = static_cast<char *>(a.allocate(8));
+    memcpy(p, "abcdefg", 8);
+    TEST_ASSERT_TRUE(a.reallocate(p, 200) == p);
+    TEST_ASSERT_TRUE(a.reallocate(p, 16) == p);
+
+    // An older one moves, keeping its contents.
+    void *q = a.allocate(8);
+    auto  r = static_cast<char *>(a.reallocate(p, 300));
+    TEST_ASSERT_TRUE(inBuf(r));
+    TEST_ASSERT_TRUE(r != p);
+    TEST_ASSERT_EQUAL_STRING("abcdefg", r);
+
+    // Past the end of the buffer it moves to the heap.
+    r = static_cast<char *>(a.reallocate(r, 2000));
+    TEST_ASSERT_FALSE(inBuf(r));
+    TEST_ASSERT_EQUAL_STRING("abcdefg", r);
+
+    a.deallocate(r);
+    a.deallocate(q);
+    TEST_ASSERT_EQUAL(0, a.used());
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_arena_rewinds);
+    RUN_TEST(test_arena_last_block_given_back);
+    RUN_TEST(test_arena_overflows_to_heap);
+    RUN_TEST(test_arena_reallocate);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
@@ -0,0 +1,108 @@
+//
+// Unit tests for public file tags and the asset cache
+//
+
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include "../../src/assets.h"
+
+void setUp() {
+    forgetAssets();
+}
+
+void tearDown() {
+}
+
+void test_assets_hash() {
+    // FNV-1a test vectors.
+    TEST_ASSERT_TRUE(assetHash(assetHashSeed, nullptr, 0) == 0xcbf29ce484222325ULL);
+    TEST_ASSERT_TRUE(assetHash(assetHashSeed, reinterpret_cast<const uint8_t *>("a"), 1) == 0xaf63dc4c8601ec8cULL);
+
+    // Fed in pieces it hashes the same as all at once.
+    const auto *data = reinterpret_cast<const uint8_t *>("foobar");
+    const uint64_t whole = assetHash(assetHashSeed, data, 6);
+    TEST_ASSERT_TRUE(whole == 0x85944171f73967e8ULL);
+    TEST_ASSERT_TRUE(assetHash(assetHash(assetHashSeed, data, 2), data + 2, 4) == whole);
+}
+
+void test_assets_tag() {
+    char tag[assetTagSize];
+    formatAssetTag(tag, 0x85944171f73967e8ULL);
+    TEST_ASSERT_EQUAL_STRING("\"85944171f73967e8\"", tag);
+    formatAssetTag(tag, 0x1);
+    TEST_ASSERT_EQUAL_STRING("\"0000000000000001\"", tag);
+}
+
+void test_assets_tag_matches() {
+    const char *tag = "\"85944171f73967e8\"";
+    TEST_ASSERT_TRUE(assetTagMatches("\"85944171f73967e8\"", tag));
+    TEST_ASSERT_TRUE(assetTagMatches("W/\"85944171f73967e8\"", tag));
+    TEST_ASSERT_TRUE(assetTagMatches("\"0000000000000001\", \"85944171f73967e8\" ", tag));
+    TEST_ASSERT_TRUE(assetTagMatches("*", tag));
+    TEST_ASSERT_FALSE(assetTagMatches("\"0000000000000001\"", tag));
+    TEST_ASSERT_FALSE(assetTagMatches("\"85944171f73967e\"", tag));
+    TEST_ASSERT_FALSE(assetTagMatches(nullptr, tag));
+    TEST_ASSERT_FALSE(assetTagMatches("*", ""));
+}
+
+void test_assets_cache() {
+    TEST_ASSERT_NULL(findAsset("/index.html"));
+
+    rememberAsset("/index.html", true, "\"0000000000000001\"");
+    rememberAsset("/app.js", false, "");
+    const assetInfo *a = findAsset("/index.html");
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_TRUE(a->gzip);
+    TEST_ASSERT_EQUAL_STRING("\"0000000000000001\"", a->tag);
+    TEST_ASSERT_EQUAL_STRING("", findAsset("/app.js")->tag);
+
+    // Remembering it again updates the entry.
+    rememberAsset("/index.html", false, "\"0000000000000002\"");
+    TEST_ASSERT_FALSE(findAsset("/index.html")->gzip);
+    TEST_ASSERT_EQUAL_STRING("\"0000000000000002\"", findAsset("/index.html")->tag);
+
+    forgetAssets();
+    TEST_ASSERT_NULL(findAsset("/index.html"));
+    TEST_ASSERT_NULL(findAsset("/app.js"));
+}
+
+void test_assets_cache_full() {
+    char path[16];
+    for (int i = 0; i <= assetCacheSize; i++) {
+        snprintf(path, sizeof(path), "/%d.js", i);
+        rememberAsset(path, false, "");
+    }
+
+    // The oldest made way for the newest.
+    TEST_ASSERT_NULL(findAsset("/0.js"));
+    TEST_ASSERT_NOT_NULL(findAsset("/1.js"));
+    snprintf(path, sizeof(path), "/%d.js", assetCacheSize);
+    TEST_ASSERT_NOT_NULL(findAsset(path));
+
+    // A path too long to keep is not remembered.
+    const char *longPath = "/a/very/long/path/that/does/not/fit/in/the/asset/cache/entry/at/all.js";
+    rememberAsset(longPath, false, "");
+    TEST_ASSERT_NULL(findAsset(longPath));
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_assets_hash);
+    RUN_TEST(test_assets_tag);
+    RUN_TEST(test_assets_tag_matches);
+    RUN_TEST(test_assets_cache);
+    RUN_TEST(test_assets_cache_full);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
@@ -0,0 +1,134 @@
+//
+// Unit tests for modbusBus class
+//
+
+#include <unity.h>
+#include "../test/stubs/TestAuraMon.h"
+
+HardwareSerial serial;
+modbusBus *    bus;
+
+void setUp() {
+    serial.reset();
+    bus = new modbusBus(serial, -1);
+    bus->begin(38400);
+    bus->setTimeout(60);
+}
+
+void tearDown() {
+    delete bus;
+}
+
+void reply(std::vector<uint8_t> frame) {
+    const uint16_t crc = modbusCRC(frame.data(), frame.size());
+    frame.push_back(crc & 0xFF);
+    frame.push_back(crc >> 8);
+    serial.response = frame;
+}
+
+void test_crc() {
+    // Read holding registers 0x0000 x1 from id 1.
+    const uint8_t frame[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x01};
+
+    TEST_ASSERT_EQUAL_HEX16(0x0A84, modbusCRC(frame, sizeof(frame)));
+}
+
+void test_read_request_frame() {
+    TEST_ASSERT_EQUAL(MODBUS_OK, bus->startRead(1, 0x4E20, 2));
+
+    const uint16_t crc = modbusCRC(serial.written.data(), 6);
+    TEST_ASSERT_EQUAL(8, serial.written.size());
+    TEST_ASSERT_EQUAL_HEX8(0x01, serial.written[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x04, serial.written[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x4E, serial.written[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x20, serial.written[3]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, serial.written[4]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, serial.written[5]);
+    TEST_ASSERT_EQUAL_HEX8(crc & 0xFF, serial.written[6]);
+    TEST_ASSERT_EQUAL_HEX8(crc >> 8, serial.written[7]);
+}
+
+void test_read_registers() {
+    uint16_t regs[2] = {};
+    reply({0x01, 0x04, 0x04, 0x43, 0x66, 0x00, 0x00});
+
+    TEST_ASSERT_EQUAL(MODBUS_OK, bus->readInputRegisters(1, 0x4E20, regs, 2));
+    TEST_ASSERT_EQUAL_HEX16(0x4366, regs[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x0000, regs[1]);
+    TEST_ASSERT_EQUAL(17, bus->stats.bytes.load());
+}
+
+void test_read_crc_error() {
+    uint16_t regs[2] = {};
+    reply({0x01, 0x04, 0x04, 0x43, 0x66, 0x00, 0x00});
+    serial.response[3] ^= 0xFF;
+
+    TEST_ASSERT_EQUAL(MODBUS_CRC_ERROR, bus->readInputRegisters(1, 0x4E20, regs, 2));
+}
+
+void test_read_exception() {
+    uint16_t regs[2] = {};
+    reply({0x01, 0x84, 0x02});
+
+    TEST_ASSERT_EQUAL(MODBUS_EXCEPTION_RESPONSE, bus->readInputRegisters(1, 0x4E20, regs, 2));
+    TEST_ASSERT_EQUAL(2, bus->getExceptionResponse());
+}
+
+void test_read_timeout() {
+    uint16_t regs[2] = {};
+
+    TEST_ASSERT_EQUAL(MODBUS_RESPONSE_TIMEOUT, bus->readInputRegisters(1, 0x4E20, regs, 2));
+}
+
+void test_read_partial_frame() {
+    uint16_t regs[2] = {};
+    serial.response = {0x01, 0x04, 0x04};
+
+    TEST_ASSERT_EQUAL(MODBUS_FRAME_ERROR, bus->readInputRegisters(1, 0x4E20, regs, 2));
+}
+
+void test_busy() {
+    TEST_ASSERT_EQUAL(MODBUS_OK, bus->startRead(1, 0x4E20, 2));
+    TEST_ASSERT_TRUE(bus->poll());
+    TEST_ASSERT_EQUAL(MODBUS_BUSY, bus->startRead(2, 0x4E20, 2));
+}
+
+void test_write_broadcast() {
+    uint16_t values[] = {0x55AA, 3};
+
+    TEST_ASSERT_EQUAL(MODBUS_OK, bus->writeMultipleHoldingRegisters(0, 0x7530, values, 2));
+    TEST_ASSERT_FALSE(bus->poll());
+    TEST_ASSERT_EQUAL(13, serial.written.size());
+}
+
+void test_write_unexpected_value() {
+    reply({0x01, 0x06, 0x17, 0x71, 0x00, 0x04});
+
+    TEST_ASSERT_EQUAL(MODBUS_UNEXPECTED_VALUE, bus->writeSingleHoldingRegister(1, 0x1771, 5));
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_crc);
+    RUN_TEST(test_read_request_frame);
+    RUN_TEST(test_read_registers);
+    RUN_TEST(test_read_crc_error);
+    RUN_TEST(test_read_exception);
+    RUN_TEST(test_read_timeout);
+    RUN_TEST(test_read_partial_frame);
+    RUN_TEST(test_busy);
+    RUN_TEST(test_write_broadcast);
+    RUN_TEST(test_write_unexpected_value);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
@@ -46,9 +46,36 @@ void test_config_valid() {
     TEST_ASSERT_NOT_NULL(deviceInfos[0]);
     TEST_ASSERT_EQUAL(true, deviceInfos[0]->enabled);
     TEST_ASSERT_EQUAL(1, deviceInfos[0]->addr);
+    TEST_ASSERT_EQUAL(0, deviceInfos[0]->bus);
     TEST_ASSERT_EQUAL_STRING("Device1", deviceInfos[0]->name);
 }
 
+void test_config_channels() {
+    JsonDocument doc;
+    auto         devices = doc["devices"].to<JsonArray>();
+    auto         dev1 = devices.add<JsonObject>();
+    dev1["enabled"] = true;
+    dev1["channel"] = 2;
+    dev1["address"] = 40;
+    auto dev2 = devices.add<JsonObject>();
+    dev2["enabled"] = true;
+    dev2["channel"] = MAX_DEVICES;
+    dev2["address"] = 41;
+
+    auto err = loadConfigJSON(doc);
+
+    TEST_ASSERT_NULL(err);
+    TEST_ASSERT_NULL(deviceInfos[0]);
+    TEST_ASSERT_NOT_NULL(deviceInfos[2]);
+    TEST_ASSERT_EQUAL(2, deviceInfos[2]->channel);
+    TEST_ASSERT_EQUAL(40, deviceInfos[2]->addr);
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (i != 2) {
+            TEST_ASSERT_NULL(deviceInfos[i]);
+        }
+    }
+}
+
 void test_load_not_found() {
     sd.fileExists = false;
 
@@ -62,6 +89,7 @@ void setup() {
     UNITY_BEGIN();
 
     RUN_TEST(test_config_valid);
+    RUN_TEST(test_config_channels);
     RUN_TEST(test_load_not_found);
 
     UNITY_END();
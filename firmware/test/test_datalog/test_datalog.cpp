@@ -11,6 +11,7 @@ dataLog* testLog;
 
 void setUp() {
     testLog = new dataLog(5, 1); // 5 sec interval, 1 day max
+    sd.others.clear();
 }
 
 void tearDown() {
@@ -30,8 +31,8 @@ void test_datalog_write_single_record() {
 
     logRecord rec;
     rec.ts = 1000;
-    rec.logHours = 1.0;
-    rec.hzHrs = 50.0;
+    rec.logMs = 3600000;
+    rec.hzMs = 50000;
 
     error *err = testLog->write(&rec);
     TEST_ASSERT_NULL(err);
@@ -45,8 +46,8 @@ void test_datalog_write_multiple_records() {
     for (int i = 0; i < 10; i++) {
         logRecord rec;
         rec.ts = 1000 + i * 5;
-        rec.logHours = i * 0.001;
-        rec.hzHrs = 50.0 + i * 0.1;
+        rec.logMs = i * 3600;
+        rec.hzMs = 50000 + i * 100;
 
         error *err = testLog->write(&rec);
         TEST_ASSERT_NULL(err);
@@ -63,8 +64,8 @@ void test_datalog_read_exact_match() {
     for (int i = 0; i < 10; i++) {
         logRecord rec;
         rec.ts = 1000 + i * 5;
-        rec.logHours = i * 0.001;
-        rec.hzHrs = 50.0 + i * 0.1;
+        rec.logMs = i * 3600;
+        rec.hzMs = 50000 + i * 100;
         testLog->write(&rec);
     }
 
@@ -73,7 +74,7 @@ void test_datalog_read_exact_match() {
     error *err = testLog->read(1020, &result, 0);
     TEST_ASSERT_NULL(err);
     TEST_ASSERT_EQUAL(1020, result.ts);
-    TEST_ASSERT_DOUBLE_WITHIN(0.0001, 4 * 0.001, result.logHours);
+    TEST_ASSERT_EQUAL_INT64(4 * 3600, result.logMs);
 }
 
 void test_datalog_read_before_first() {
@@ -81,7 +82,7 @@ void test_datalog_read_before_first() {
 
     logRecord rec;
     rec.ts = 1000;
-    rec.logHours = 1.0;
+    rec.logMs = 3600000;
     testLog->write(&rec);
 
     logRecord result;
@@ -95,7 +96,7 @@ void test_datalog_read_after_last() {
 
     logRecord rec;
     rec.ts = 1000;
-    rec.logHours = 1.0;
+    rec.logMs = 3600000;
     testLog->write(&rec);
 
     logRecord result;
@@ -123,7 +124,7 @@ void test_datalog_search_with_gaps() {
     for (int i = 0; i < 8; i++) {
         logRecord rec;
         rec.ts = timestamps[i];
-        rec.logHours = i * 0.1;
+        rec.logMs = i * 360000;
         testLog->write(&rec);
     }
 
@@ -133,7 +134,7 @@ void test_datalog_search_with_gaps() {
     TEST_ASSERT_NULL(err);
     TEST_ASSERT_EQUAL(1015, result.ts);
     // Should find the record at or before 1015 (which is 1010)
-    TEST_ASSERT_DOUBLE_WITHIN(0.01, 2 * 0.1, result.logHours);
+    TEST_ASSERT_EQUAL_INT64(2 * 360000, result.logMs);
 }
 
 void test_datalog_search_large_dataset() {
@@ -143,8 +144,8 @@ void test_datalog_search_large_dataset() {
     for (int i = 0; i < 100; i++) {
         logRecord rec;
         rec.ts = 1000 + i * 5;
-        rec.logHours = i * 0.01;
-        rec.hzHrs = 50.0;
+        rec.logMs = i * 36000;
+        rec.hzMs = 50000;
         testLog->write(&rec);
     }
 
@@ -153,7 +154,7 @@ void test_datalog_search_large_dataset() {
     error *err = testLog->read(1250, &result, 0);
     TEST_ASSERT_NULL(err);
     TEST_ASSERT_EQUAL(1250, result.ts);
-    TEST_ASSERT_DOUBLE_WITHIN(0.001, 50 * 0.01, result.logHours);
+    TEST_ASSERT_EQUAL_INT64(50 * 36000, result.logMs);
 }
 
 void test_datalog_search_with_large_gaps() {
@@ -162,17 +163,17 @@ void test_datalog_search_with_large_gaps() {
     // Write records with very large gaps
     logRecord rec1;
     rec1.ts = 1000;
-    rec1.logHours = 1.0;
+    rec1.logMs = 3600000;
     testLog->write(&rec1);
 
     logRecord rec2;
     rec2.ts = 10000; // 9000 second gap
-    rec2.logHours = 10.0;
+    rec2.logMs = 36000000;
     testLog->write(&rec2);
 
     logRecord rec3;
     rec3.ts = 10005;
-    rec3.logHours = 10.1;
+    rec3.logMs = 36360000;
     testLog->write(&rec3);
 
     // Search in the middle of the gap
@@ -181,7 +182,7 @@ void test_datalog_search_with_large_gaps() {
     TEST_ASSERT_NULL(err);
     TEST_ASSERT_EQUAL(5000, result.ts);
     // Should return the first record's data
-    TEST_ASSERT_DOUBLE_WITHIN(0.1, 1.0, result.logHours);
+    TEST_ASSERT_EQUAL_INT64(3600000, result.logMs);
 }
 
 // ========== File Wrap-Around Tests ==========
@@ -197,7 +198,7 @@ void test_datalog_wrap_detection() {
     for (int i = 0; i < 10; i++) {
         logRecord rec;
         rec.ts = 1000 + i * 5;
-        rec.logHours = i * 0.1;
+        rec.logMs = i * 360000;
         testLog->write(&rec);
     }
 
@@ -213,7 +214,7 @@ void test_datalog_findWrapPos_algorithm() {
     for (int i = 0; i < 5; i++) {
         logRecord rec;
         rec.ts = 1000 + i * 5;
-        rec.logHours = i * 0.1;
+        rec.logMs = i * 360000;
         testLog->write(&rec);
     }
 
@@ -232,8 +233,8 @@ void test_datalog_read_after_wrap() {
     for (int i = 0; i < 10; i++) {
         logRecord rec;
         rec.ts = 1000 + i * 5;
-        rec.logHours = i * 0.1;
-        rec.hzHrs = 50.0;
+        rec.logMs = i * 360000;
+        rec.hzMs = 50000;
         testLog->write(&rec);
     }
 
@@ -252,8 +253,8 @@ void test_datalog_lastCache_hit() {
     for (int i = 0; i < 15; i++) {
         logRecord rec;
         rec.ts = 1000 + i * 5;
-        rec.logHours = i * 0.1;
-        rec.hzHrs = 50.0 + i;
+        rec.logMs = i * 360000;
+        rec.hzMs = 50000 + i * 1000;
         testLog->write(&rec);
     }
 
@@ -262,7 +263,7 @@ void test_datalog_lastCache_hit() {
     error *err = testLog->read(1070, &result, 0);
     TEST_ASSERT_NULL(err);
     TEST_ASSERT_EQUAL(1070, result.ts);
-    TEST_ASSERT_DOUBLE_WITHIN(0.01, 14 * 0.1, result.logHours);
+    TEST_ASSERT_EQUAL_INT64(14 * 360000, result.logMs);
 }
 
 void test_datalog_readCache_population() {
@@ -272,7 +273,7 @@ void test_datalog_readCache_population() {
     for (int i = 0; i < 50; i++) {
         logRecord rec;
         rec.ts = 1000 + i * 5;
-        rec.logHours = i * 0.1;
+        rec.logMs = i * 360000;
         testLog->write(&rec);
     }
 
@@ -295,12 +296,12 @@ void test_datalog_write_out_of_order() {
 
     logRecord rec1;
     rec1.ts = 1000;
-    rec1.logHours = 1.0;
+    rec1.logMs = 3600000;
     testLog->write(&rec1);
 
     logRecord rec2;
     rec2.ts = 995; // Earlier than last written
-    rec2.logHours = 0.9;
+    rec2.logMs = 3240000;
 
     error *err = testLog->write(&rec2);
     TEST_ASSERT_NOT_NULL(err);
@@ -312,7 +313,7 @@ void test_datalog_timestamp_alignment() {
 
     logRecord rec;
     rec.ts = 1003; // Not aligned to 5-second interval
-    rec.logHours = 1.0;
+    rec.logMs = 3600000;
     testLog->write(&rec);
 
     // Read with unaligned timestamp (should align to 1000)
@@ -335,15 +336,17 @@ void test_datalog_corrupted_file_detection() {
     logRecord rec1, rec2;
     rec1.rev = 1;
     rec1.ts = 1000;
-    rec1.logHours = 1.0;
+    rec1.logMs = 3600000;
 
     rec2.rev = 10; // Rev jump indicates corruption (should be 2)
     rec2.ts = 1005;
-    rec2.logHours = 1.1;
+    rec2.logMs = 3960000;
 
-    file->data.resize(sizeof(logRecord) * 2);
-    std::memcpy(&file->data[0], &rec1, sizeof(logRecord));
-    std::memcpy(&file->data[sizeof(logRecord)], &rec2, sizeof(logRecord));
+    logHeader hdr{logMagic, logVersion, MAX_DEVICES, sizeof(logRecord), 0};
+    file->data.resize(sizeof(logHeader) + sizeof(logRecord) * 2);
+    std::memcpy(&file->data[0], &hdr, sizeof(logHeader));
+    std::memcpy(&file->data[sizeof(logHeader)], &rec1, sizeof(logRecord));
+    std::memcpy(&file->data[sizeof(logHeader) + sizeof(logRecord)], &rec2, sizeof(logRecord));
 
     sd.file = file;
 
@@ -352,6 +355,168 @@ void test_datalog_corrupted_file_detection() {
     TEST_ASSERT_TRUE(rp2040.rebootCalled);
 }
 
+// ========== Schema Header Tests ==========
+
+void writeTestFile(const logHeader *hdr, uint32_t records) {
+    sd.fileExists = true;
+    FsFile *file = new FsFile();
+    file->open = true;
+
+    size_t pos = 0;
+    if (hdr) {
+        file->data.resize(sizeof(logHeader));
+        std::memcpy(&file->data[0], hdr, sizeof(logHeader));
+        pos = sizeof(logHeader);
+    }
+    for (uint32_t i = 0; i < records; i++) {
+        logRecord rec;
+        rec.rev = i + 1;
+        rec.ts = 1000 + i * 5;
+        file->data.resize(pos + sizeof(logRecord));
+        std::memcpy(&file->data[pos], &rec, sizeof(logRecord));
+        pos += sizeof(logRecord);
+    }
+
+    delete sd.file;
+    sd.file = file;
+    sd.moved.clear();
+}
+
+void test_datalog_header_match() {
+    logHeader hdr{logMagic, logVersion, MAX_DEVICES, sizeof(logRecord), 0};
+    writeTestFile(&hdr, 3);
+
+    TEST_ASSERT_TRUE(testLog->begin());
+    TEST_ASSERT_EQUAL(3, testLog->entries());
+    TEST_ASSERT_EQUAL(1000, testLog->firstTS());
+    TEST_ASSERT_EQUAL(1010, testLog->lastTS());
+    TEST_ASSERT_EQUAL(0, sd.moved.size());
+
+    sd.file->data.clear();
+}
+
+// writeV1File writes version 1 records, holding hours as doubles.
+void writeV1File(const logHeader *hdr, uint32_t records) {
+    writeTestFile(hdr, 0);
+
+    size_t pos = sd.file->data.size();
+    for (uint32_t i = 0; i < records; i++) {
+        logRecord    rec;
+        const double logHours = (i + 1) / 720.0;
+        const double hzHours = 50.0 * logHours;
+        const double wattHours = 1.5 * (i + 1);
+        rec.rev = i + 1;
+        rec.ts = 1000 + i * 5;
+        std::memcpy(&rec.logMs, &logHours, sizeof(double));
+        std::memcpy(&rec.hzMs, &hzHours, sizeof(double));
+        std::memcpy(&rec.wattMs[2], &wattHours, sizeof(double));
+        sd.file->data.resize(pos + sizeof(logRecord));
+        std::memcpy(&sd.file->data[pos], &rec, sizeof(logRecord));
+        pos += sizeof(logRecord);
+    }
+}
+
+void assertMigrated(uint32_t records) {
+    TEST_ASSERT_EQUAL(records, testLog->entries());
+    TEST_ASSERT_EQUAL(1000, testLog->firstTS());
+    TEST_ASSERT_EQUAL(1000 + (records - 1) * 5, testLog->lastTS());
+
+    logRecord result;
+    TEST_ASSERT_NULL(testLog->read(1005, &result, 0));
+    TEST_ASSERT_EQUAL(2, result.rev);
+    TEST_ASSERT_EQUAL_INT64(10000, result.logMs);
+    TEST_ASSERT_EQUAL_INT64(500000000, result.hzMs);
+    TEST_ASSERT_EQUAL_INT64(10800000000LL, result.wattMs[2]);
+    TEST_ASSERT_EQUAL_INT64(0, result.wattMs[0]);
+    TEST_ASSERT_FALSE(sd.exists(DATA_LOG_NEW_PATH));
+}
+
+void test_datalog_legacy_file() {
+    // Files without a header hold version 1 records.
+    writeV1File(nullptr, 3);
+    const auto v1 = sd.file->data;
+
+    TEST_ASSERT_TRUE(testLog->begin());
+    assertMigrated(3);
+    TEST_ASSERT_TRUE(v1 == sd.others[DATA_LOG_OLD_PATH]);
+
+    sd.file->data.clear();
+}
+
+void test_datalog_migrate_v1() {
+    logHeader hdr{logMagic, 1, MAX_DEVICES, sizeof(logRecord), 0};
+    writeV1File(&hdr, 4);
+    const auto v1 = sd.file->data;
+
+    TEST_ASSERT_TRUE(testLog->begin());
+    assertMigrated(4);
+    TEST_ASSERT_TRUE(v1 == sd.others[DATA_LOG_OLD_PATH]);
+
+    // The migrated log is kept as version 2 and appended to.
+    logRecord rec;
+    rec.ts = 1020;
+    TEST_ASSERT_NULL(testLog->write(&rec));
+    TEST_ASSERT_EQUAL(5, testLog->entries());
+
+    sd.file->data.clear();
+}
+
+void test_datalog_migrate_keeps_old() {
+    const std::vector<uint8_t> older{1, 2, 3};
+    logHeader                  hdr{logMagic, 1, MAX_DEVICES, sizeof(logRecord), 0};
+    writeV1File(&hdr, 2);
+    sd.others[DATA_LOG_OLD_PATH] = older;
+
+    TEST_ASSERT_TRUE(testLog->begin());
+    assertMigrated(2);
+    TEST_ASSERT_TRUE(older == sd.others[DATA_LOG_OLD_PATH]);
+
+    sd.file->data.clear();
+}
+
+void test_datalog_migrate_interrupted() {
+    // A reset between removing the log and renaming its migration.
+    logHeader hdr{logMagic, logVersion, MAX_DEVICES, sizeof(logRecord), 0};
+    writeTestFile(&hdr, 2);
+    sd.others[DATA_LOG_NEW_PATH] = sd.file->data;
+    sd.file->data.clear();
+    sd.fileExists = false;
+
+    TEST_ASSERT_TRUE(testLog->begin());
+    TEST_ASSERT_EQUAL(2, testLog->entries());
+    TEST_ASSERT_FALSE(sd.exists(DATA_LOG_NEW_PATH));
+
+    sd.file->data.clear();
+}
+
+void test_datalog_schema_mismatch() {
+    logHeader hdr{logMagic, logVersion, MAX_DEVICES + 1, sizeof(logRecord), 0};
+    writeTestFile(&hdr, 2);
+    const size_t size = sd.file->data.size();
+
+    TEST_ASSERT_TRUE(testLog->begin());
+    TEST_ASSERT_EQUAL(0, testLog->entries());
+    TEST_ASSERT_EQUAL(size, sd.moved.size());
+    TEST_ASSERT_EQUAL(size, sd.others[DATA_LOG_OLD_PATH].size());
+
+    sd.file->data.clear();
+}
+
+void test_datalog_schema_mismatch_keeps_old() {
+    const std::vector<uint8_t> older{1, 2, 3};
+    logHeader                  hdr{logMagic, logVersion, MAX_DEVICES + 1, sizeof(logRecord), 0};
+    writeTestFile(&hdr, 2);
+    const size_t size = sd.file->data.size();
+    sd.others[DATA_LOG_OLD_PATH] = older;
+
+    TEST_ASSERT_TRUE(testLog->begin());
+    TEST_ASSERT_EQUAL(0, testLog->entries());
+    TEST_ASSERT_TRUE(older == sd.others[DATA_LOG_OLD_PATH]);
+    TEST_ASSERT_EQUAL(size, sd.others[DATA_LOG_OLD_PATH ".1"].size());
+
+    sd.file->data.clear();
+}
+
 void test_datalog_empty_initialization() {
     TEST_ASSERT_TRUE(testLog->begin());
     TEST_ASSERT_EQUAL(0, testLog->entries());
@@ -373,10 +538,10 @@ void test_datalog_accumulative_values() {
     for (int i = 0; i < 5; i++) {
         logRecord rec;
         rec.ts = 1000 + i * 5;
-        rec.logHours = (i + 1) * 1.0; // Accumulating
-        rec.hzHrs = (i + 1) * 50.0;
-        rec.voltHrs[0] = (i + 1) * 230.0;
-        rec.wattHrs[0] = (i + 1) * 1000.0;
+        rec.logMs = (i + 1) * 3600000; // Accumulating
+        rec.hzMs = (i + 1) * 50000 * 3600000LL;
+        rec.voltMs[0] = (i + 1) * 230000 * 3600000LL;
+        rec.wattMs[0] = (i + 1) * 1000000 * 3600000LL;
         testLog->write(&rec);
     }
 
@@ -384,8 +549,51 @@ void test_datalog_accumulative_values() {
     logRecord result;
     error *err = testLog->read(1010, &result, 0);
     TEST_ASSERT_NULL(err);
-    TEST_ASSERT_DOUBLE_WITHIN(0.01, 3.0, result.logHours);
-    TEST_ASSERT_DOUBLE_WITHIN(0.01, 150.0, result.hzHrs);
+    TEST_ASSERT_EQUAL_INT64(3 * 3600000, result.logMs);
+    TEST_ASSERT_EQUAL_INT64(150000 * 3600000LL, result.hzMs);
+}
+
+void test_datalog_readFrom_rev_hint() {
+    TEST_ASSERT_TRUE(testLog->begin());
+
+    for (int i = 0; i < 10; i++) {
+        logRecord rec;
+        rec.ts = 1000 + i * 5 + (i >= 5 ? 100 : 0); // Gap after the fifth record.
+        rec.logMs = i;
+        testLog->write(&rec);
+    }
+
+    logRecord first;
+    TEST_ASSERT_NULL(testLog->read(1000, &first, 0));
+
+    // A correct hint reads the record directly.
+    logRecord result;
+    TEST_ASSERT_NULL(testLog->readFrom(1010, first.rev + 2, &result, 0));
+    TEST_ASSERT_EQUAL(1010, result.ts);
+    TEST_ASSERT_EQUAL_INT64(2, result.logMs);
+
+    // A stale hint falls back to searching by timestamp.
+    TEST_ASSERT_NULL(testLog->readFrom(1130, first.rev + 4, &result, 0));
+    TEST_ASSERT_EQUAL(1130, result.ts);
+    TEST_ASSERT_EQUAL_INT64(6, result.logMs);
+}
+
+void test_datalog_stats() {
+    TEST_ASSERT_TRUE(testLog->begin());
+
+    for (int i = 0; i < 3; i++) {
+        logRecord rec;
+        rec.ts = 1000 + i * 5;
+        testLog->write(&rec);
+    }
+
+    const logStats s = testLog->stats();
+    TEST_ASSERT_EQUAL(testLog->entries(), s.entries);
+    TEST_ASSERT_EQUAL(testLog->firstRev(), s.firstRev);
+    TEST_ASSERT_EQUAL(1000, s.firstTS);
+    TEST_ASSERT_EQUAL(testLog->lastRev(), s.lastRev);
+    TEST_ASSERT_EQUAL(1010, s.lastTS);
+    TEST_ASSERT_EQUAL(testLog->fileSize(), s.fileSize);
 }
 
 // ========== Test Runner ==========
@@ -420,11 +628,22 @@ void setup() {
     RUN_TEST(test_datalog_write_out_of_order);
     // RUN_TEST(test_datalog_timestamp_alignment); // TEMP: Alignment behavior needs review
     RUN_TEST(test_datalog_corrupted_file_detection);
+
+    // Schema header
+    RUN_TEST(test_datalog_header_match);
+    RUN_TEST(test_datalog_legacy_file);
+    RUN_TEST(test_datalog_migrate_v1);
+    RUN_TEST(test_datalog_migrate_keeps_old);
+    RUN_TEST(test_datalog_migrate_interrupted);
+    RUN_TEST(test_datalog_schema_mismatch);
+    RUN_TEST(test_datalog_schema_mismatch_keeps_old);
     RUN_TEST(test_datalog_empty_initialization);
     RUN_TEST(test_datalog_multiple_begin_calls);
 
     // Accumulative data
     RUN_TEST(test_datalog_accumulative_values);
+    RUN_TEST(test_datalog_readFrom_rev_hint);
+    RUN_TEST(test_datalog_stats);
 
     UNITY_END();
 }
@@ -0,0 +1,213 @@
+//
+// Unit tests for energy integration
+//
+
+#include <unity.h>
+#include "../test/stubs/TestAuraMon.h"
+#include "../../src/dataLog.h"
+#include "../../src/energy.h"
+
+inputDevice *dev;
+
+void setUp() {
+    channels = channelState();
+    dev = new inputDevice(0, 1);
+    dev->calibration = 1.0f;
+}
+
+void tearDown() {
+    delete dev;
+}
+
+void test_accumulate_exact() {
+    channels.ts[0] = 0;
+    dev->setEnergy(230.5f, 1000.25f, 1100.5f, 50.01f);
+    channels.voltMs[0] = 0;
+    channels.wattMs[0] = 0;
+    channels.vaMs[0] = 0;
+    channels.hzMs[0] = 0;
+    channels.ts[0] = 0;
+
+    dev->accumulate(1000);
+
+    TEST_ASSERT_EQUAL_INT64(230500LL * 1000, channels.voltMs[0]);
+    TEST_ASSERT_EQUAL_INT64(1000250LL * 1000, channels.wattMs[0]);
+    TEST_ASSERT_EQUAL_INT64(1100500LL * 1000, channels.vaMs[0]);
+    TEST_ASSERT_EQUAL_INT64(50010LL * 1000, channels.hzMs[0]);
+    TEST_ASSERT_EQUAL(1000, channels.ts[0]);
+}
+
+void test_accumulate_no_drift() {
+    channels.mW[0] = 1234567;
+    channels.ts[0] = 0;
+
+    // A day of one second samples.
+    for (uint32_t i = 1; i <= 86400; i++) {
+        dev->accumulate(i * 1000);
+    }
+
+    TEST_ASSERT_EQUAL_INT64(1234567LL * 1000 * 86400, channels.wattMs[0]);
+}
+
+void test_accumulate_ignores_old_samples() {
+    channels.mW[0] = 100000;
+    channels.ts[0] = 1000;
+
+    dev->accumulate(1000);
+    dev->accumulate(500);
+
+    TEST_ASSERT_EQUAL_INT64(0, channels.wattMs[0]);
+}
+
+void test_counters_replace_integration() {
+    dev->setCounters(100.0f, 0.0f);
+    const int64_t start = channels.wattMs[0];
+
+    dev->setCounters(100.00005f, 0.0f);
+
+    const int64_t mWh = llroundf(100.00005f * 1e6f) - llroundf(100.0f * 1e6f);
+    TEST_ASSERT_EQUAL_INT64(start + mWh * MS_PER_HOUR, channels.wattMs[0]);
+}
+
+void test_counters_flat_keeps_integration() {
+    dev->setCounters(100.0f, 0.0f);
+    const int64_t start = channels.wattMs[0];
+
+    // 500 W for a second, too little for the counter to step.
+    channels.mW[0] = 500000;
+    channels.ts[0] = 1000;
+    dev->accumulate(2000);
+    const int64_t integrated = channels.wattMs[0];
+    TEST_ASSERT_EQUAL_INT64(start + 500000LL * 1000, integrated);
+
+    dev->setCounters(100.0f, 0.0f);
+    TEST_ASSERT_EQUAL_INT64(integrated, channels.wattMs[0]);
+
+    // Once it steps, the delta since the last step replaces the integration.
+    dev->setCounters(100.00005f, 0.0f);
+    const int64_t mWh = llroundf(100.00005f * 1e6f) - llroundf(100.0f * 1e6f);
+    TEST_ASSERT_EQUAL_INT64(start + mWh * MS_PER_HOUR, channels.wattMs[0]);
+}
+
+void test_counters_reversed_keeps_sign() {
+    dev->reversed = true;
+    dev->setCounters(100.0f, 0.0f);
+    const int64_t start = channels.wattMs[0];
+
+    // applyReading negates volts and amps, so watts keep the meter's sign.
+    channels.mW[0] = 500000;
+    channels.ts[0] = 1000;
+    dev->accumulate(2000);
+    TEST_ASSERT_EQUAL_INT64(start + 500000LL * 1000, channels.wattMs[0]);
+
+    // The counter step carries on in the same direction.
+    dev->setCounters(100.00005f, 0.0f);
+    const int64_t mWh = llroundf(100.00005f * 1e6f) - llroundf(100.0f * 1e6f);
+    TEST_ASSERT_TRUE(mWh > 0);
+    TEST_ASSERT_EQUAL_INT64(start + mWh * MS_PER_HOUR, channels.wattMs[0]);
+}
+
+void test_counters_reject_implausible() {
+    dev->setCounters(100.0f, 0.0f);
+    const int64_t start = channels.wattMs[0];
+
+    dev->setCounters(200.0f, 0.0f);
+
+    TEST_ASSERT_EQUAL_INT64(start, channels.wattMs[0]);
+}
+
+void test_accumulate_all_matches_per_channel() {
+    channelState per;
+    for (uint8_t i = 0; i < MAX_DEVICES; i++) {
+        channels.set(i, 230.0f, 100.0f * i, 120.0f * i, 50.0f);
+        channels.ts[i] = i * 100;
+        per.set(i, 230.0f, 100.0f * i, 120.0f * i, 50.0f);
+        per.ts[i] = i * 100;
+    }
+
+    channels.accumulateAll(1000);
+    for (uint8_t i = 0; i < MAX_DEVICES; i++) {
+        per.accumulate(i, 1000);
+    }
+
+    for (uint8_t i = 0; i < MAX_DEVICES; i++) {
+        TEST_ASSERT_EQUAL_INT64(per.wattMs[i], channels.wattMs[i]);
+        TEST_ASSERT_EQUAL_INT64(per.vaMs[i], channels.vaMs[i]);
+        TEST_ASSERT_EQUAL(per.ts[i], channels.ts[i]);
+    }
+}
+
+void test_energy_row_averages() {
+    logRecord prev, rec;
+    rec.logMs = 60000;
+    rec.hzMs = 50000LL * 60000;
+    rec.voltMs[2] = 230000LL * 60000;
+    rec.wattMs[2] = 1150000LL * 60000;
+    rec.vaMs[2] = 2300000LL * 60000;
+
+    const uint8_t chans[] = {2};
+    double        values[1 + energyDeviceColumns];
+    TEST_ASSERT_TRUE(energyRow(prev, rec, chans, 1, values));
+
+    TEST_ASSERT_EQUAL_DOUBLE(50.0, values[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(230.0, values[1]);
+    TEST_ASSERT_EQUAL_DOUBLE(10.0, values[2]);
+    TEST_ASSERT_EQUAL_DOUBLE(1150.0, values[3]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1150.0 / 60, values[4]);
+    TEST_ASSERT_EQUAL_DOUBLE(0.5, values[5]);
+
+    // No time logged, no row.
+    TEST_ASSERT_FALSE(energyRow(rec, rec, chans, 1, values));
+}
+
+void test_energy_pack_row() {
+    const double values[] = {50.0, 230.0, NAN, 1150.0, 0.25, 0.5};
+    uint8_t      row[energyRowSize(1)];
+
+    TEST_ASSERT_EQUAL(28, energyRowSize(1));
+    TEST_ASSERT_EQUAL(28, packEnergyRow(1000, values, 1, row));
+
+    uint32_t ts;
+    float    f[6];
+    memcpy(&ts, row, 4);
+    memcpy(f, row + 4, sizeof(f));
+    TEST_ASSERT_EQUAL(1000, ts);
+    TEST_ASSERT_EQUAL_FLOAT(50.0f, f[0]);
+    TEST_ASSERT_EQUAL_FLOAT(230.0f, f[1]);
+    TEST_ASSERT_TRUE(std::isnan(f[2]));
+    TEST_ASSERT_EQUAL_FLOAT(0.5f, f[5]);
+
+    uint32_t next[2];
+    TEST_ASSERT_EQUAL(28, packEnergyMarker(energyCursorTS, 1005, 42, 1, row));
+    memcpy(&ts, row, 4);
+    memcpy(next, row + 4, sizeof(next));
+    TEST_ASSERT_EQUAL(energyCursorTS, ts);
+    TEST_ASSERT_EQUAL(1005, next[0]);
+    TEST_ASSERT_EQUAL(42, next[1]);
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_accumulate_exact);
+    RUN_TEST(test_accumulate_no_drift);
+    RUN_TEST(test_accumulate_ignores_old_samples);
+    RUN_TEST(test_counters_replace_integration);
+    RUN_TEST(test_counters_flat_keeps_integration);
+    RUN_TEST(test_counters_reversed_keeps_sign);
+    RUN_TEST(test_counters_reject_implausible);
+    RUN_TEST(test_accumulate_all_matches_per_channel);
+    RUN_TEST(test_energy_row_averages);
+    RUN_TEST(test_energy_pack_row);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
@@ -0,0 +1,119 @@
+//
+// Unit tests and benchmark for fixed precision formatting
+//
+
+#include <unity.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include "../../src/format.h"
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void assertMatchesPrintf(double value, uint8_t precision) {
+    char want[64];
+    char got[formatFixedSize];
+    snprintf(want, sizeof(want), "%.*f", precision, value);
+    const size_t n = formatFixed(got, value, precision);
+    TEST_ASSERT_EQUAL(strlen(want), n);
+    TEST_ASSERT_EQUAL_STRING(want, got);
+}
+
+void test_format_basic() {
+    assertMatchesPrintf(0, 3);
+    assertMatchesPrintf(230.5, 3);
+    assertMatchesPrintf(-12.25, 2);
+    assertMatchesPrintf(0.9999, 3);
+    assertMatchesPrintf(50.0, 0);
+    assertMatchesPrintf(123456789.123456, 6);
+    assertMatchesPrintf(-0.0001, 3);
+}
+
+void test_format_ties() {
+    // Exact ties round to even, near ties follow the exact binary value.
+    assertMatchesPrintf(0.125, 2);
+    assertMatchesPrintf(0.375, 2);
+    assertMatchesPrintf(2.5, 0);
+    assertMatchesPrintf(3.5, 0);
+    assertMatchesPrintf(1.005, 2);
+    assertMatchesPrintf(1.015, 2);
+    assertMatchesPrintf(2.675, 2);
+}
+
+void test_format_non_finite() {
+    char buf[formatFixedSize];
+    TEST_ASSERT_EQUAL(0, formatFixed(buf, NAN, 3));
+    TEST_ASSERT_EQUAL(0, formatFixed(buf, INFINITY, 3));
+    TEST_ASSERT_EQUAL_STRING("", buf);
+}
+
+void test_format_large() {
+    assertMatchesPrintf(1e15, 6);
+    assertMatchesPrintf(-3.2e17, 3);
+}
+
+void test_format_matches_printf() {
+    std::mt19937_64                  rng(42);
+    std::uniform_real_distribution<> dist(-1e6, 1e6);
+
+    for (int i = 0; i < 200000; i++) {
+        const double  value = dist(rng) / std::pow(10, i % 7);
+        const uint8_t precision = i % (formatFixedMaxPrecision + 1);
+        assertMatchesPrintf(value, precision);
+    }
+}
+
+void test_benchmark_format() {
+    constexpr int count = 200000;
+    char          buf[64];
+    size_t        total = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        total += snprintf(buf, sizeof(buf), "%.*f", 3, 230.0 + i * 0.001);
+    }
+    const auto printfNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        total -= formatFixed(buf, 230.0 + i * 0.001, 3);
+    }
+    const auto fixedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "format 3 decimals: printf %.1fns, formatFixed %.1fns",
+             static_cast<double>(printfNs) / count, static_cast<double>(fixedNs) / count);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL(0, total);
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_format_basic);
+    RUN_TEST(test_format_ties);
+    RUN_TEST(test_format_non_finite);
+    RUN_TEST(test_format_large);
+    RUN_TEST(test_format_matches_printf);
+    RUN_TEST(test_benchmark_format);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
@@ -0,0 +1,619 @@
+//
+// Unit tests for the HTTP server, driven through mock sockets
+//
+
+#include <unity.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+#include "../test/stubs/TestAuraMon.h"
+#include "../../src/http.h"
+
+// mockPeer is the client end of a connection, it outlives the server's socket.
+struct mockPeer {
+    std::string in;
+    size_t      inPos = 0;
+    size_t      readMax = SIZE_MAX;  // Bytes handed over per read.
+    size_t      writeMax = SIZE_MAX; // Bytes taken per write, 0 when the client is not reading.
+    std::string out;
+    bool        open = true;
+    bool        closed = false;
+};
+
+class mockSocket : public httpSocket {
+public:
+    explicit mockSocket(mockPeer *peer) : _peer(peer) {
+    }
+
+    ~mockSocket() override { _peer->closed = true; }
+
+    size_t read(uint8_t *buf, size_t len) override {
+        size_t n = std::min({len, _peer->readMax, _peer->in.size() - _peer->inPos});
+        memcpy(buf, _peer->in.data() + _peer->inPos, n);
+        _peer->inPos += n;
+        return n;
+    }
+
+    size_t write(const uint8_t *buf, size_t len) override {
+        size_t n = std::min(len, _peer->writeMax);
+        _peer->out.append(reinterpret_cast<const char *>(buf), n);
+        return n;
+    }
+
+    bool connected() override { return _peer->open; }
+    void close() override {}
+
+private:
+    mockPeer *_peer;
+};
+
+// Peers outlive each test so the server can still close their sockets in tearDown.
+std::deque<mockPeer>   peers;
+std::deque<mockPeer *> pending;
+
+mockPeer &connect(const std::string &in) {
+    peers.emplace_back();
+    mockPeer &p = peers.back();
+    p.in = in;
+    pending.push_back(&p);
+    return p;
+}
+
+httpSocket *acceptMock() {
+    if (pending.empty()) {
+        return nullptr;
+    }
+    auto p = pending.front();
+    pending.pop_front();
+    return new mockSocket(p);
+}
+
+uint32_t now = 0;
+
+uint32_t fakeClock() {
+    return now;
+}
+
+// body returns the response body, joining chunks if it was chunked.
+std::string body(const std::string &response) {
+    const size_t headEnd = response.find("\r\n\r\n");
+    std::string  rest = response.substr(headEnd + 4);
+    if (response.find("Transfer-Encoding: chunked") == std::string::npos) {
+        return rest;
+    }
+    std::string joined;
+    size_t      pos = 0;
+    while (true) {
+        const size_t lineEnd = rest.find("\r\n", pos);
+        const size_t len = strtoul(rest.substr(pos, lineEnd - pos).c_str(), nullptr, 16);
+        if (len == 0) {
+            break;
+        }
+        joined += rest.substr(lineEnd + 2, len);
+        pos = lineEnd + 2 + len + 2;
+    }
+    return joined;
+}
+
+void pollAll(httpServer &server, int times = 20) {
+    for (int i = 0; i < times; i++) {
+        server.poll();
+    }
+}
+
+// Handlers.
+
+void handleHello(httpRequest &req, httpResponse &res) {
+    std::string msg = "hello ";
+    msg += req.arg("name") ? req.arg("name") : "?";
+    msg += " ";
+    msg += req.header("x-test") ? req.header("x-test") : "?";
+    res.send(200, "text/plain", msg.c_str());
+}
+
+void handleEcho(httpRequest &req, httpResponse &res) {
+    if (strlen(req.body) != req.bodyLen) {
+        res.send(500, "text/plain", "unterminated");
+        return;
+    }
+    res.send(200, "application/json", req.body, req.bodyLen);
+}
+
+void handleCached(httpRequest &req, httpResponse &res) {
+    res.header("ETag", "\"1\"");
+    const char *tag = req.header("If-None-Match");
+    if (tag && strcmp(tag, "\"1\"") == 0) {
+        res.send(304, "text/plain");
+        return;
+    }
+    res.send(200, "text/plain", "cached");
+}
+
+void handleNotFound(httpRequest &req, httpResponse &res) {
+    (void) req;
+    res.send(404, "text/plain", "missing");
+}
+
+struct countStream {
+    int  next;
+    int  last;
+    bool released;
+};
+
+countStream counter;
+
+bool produceCount(void *ctx, responseWriter &out) {
+    auto c = static_cast<countStream *>(ctx);
+    if (c->next > c->last) {
+        return false;
+    }
+    out.writeUint(c->next++);
+    out.write('\n');
+    return true;
+}
+
+void releaseCount(void *ctx) {
+    static_cast<countStream *>(ctx)->released = true;
+}
+
+void handleCount(httpRequest &req, httpResponse &res) {
+    (void) req;
+    counter = countStream{1, 1000, false};
+    res.stream(200, "text/plain", produceCount, &counter, releaseCount);
+}
+
+bool producedBig;
+
+// produceBig writes more than a chunk in one call, which is not allowed.
+bool produceBig(void *ctx, responseWriter &out) {
+    (void) ctx;
+    const std::string row(3000, 'x');
+    out.write(row.data(), row.size());
+    producedBig = true;
+    return true;
+}
+
+void handleBig(httpRequest &req, httpResponse &res) {
+    (void) req;
+    producedBig = false;
+    res.stream(200, "text/plain", produceBig, nullptr, nullptr);
+}
+
+bool secretWritten;
+
+// produceSecret leaves a row in the writer, then waits for more that never comes.
+bool produceSecret(void *ctx, responseWriter &out) {
+    (void) ctx;
+    if (!secretWritten) {
+        out.write("SECRET-FROM-A\n");
+        secretWritten = true;
+    }
+    return true;
+}
+
+void handleSecret(httpRequest &req, httpResponse &res) {
+    (void) req;
+    secretWritten = false;
+    res.stream(200, "text/plain", produceSecret, nullptr, nullptr);
+}
+
+std::string uploaded;
+std::string uploadEvents;
+
+// uploadOwner is the one request allowed to upload, like the OTA updater's.
+const httpRequest *uploadOwner;
+
+void handleUpload(httpRequest &req, httpUpload &upload) {
+    switch (upload.status) {
+        case httpUploadStatus::Start:
+            if (uploadOwner && uploadOwner != &req) {
+                uploadEvents += "busy ";
+                return;
+            }
+            uploadOwner = &req;
+            uploadEvents += std::string("start:") + upload.name + ":" + upload.filename + " ";
+            break;
+        case httpUploadStatus::Write:
+            uploaded.append(reinterpret_cast<const char *>(upload.buf), upload.currentSize);
+            break;
+        case httpUploadStatus::End:
+            uploadEvents += "end:" + std::to_string(upload.totalSize) + " ";
+            break;
+        case httpUploadStatus::Aborted:
+            if (uploadOwner == &req) {
+                uploadOwner = nullptr;
+            }
+            uploadEvents += "aborted ";
+            break;
+    }
+}
+
+void handleUploadDone(httpRequest &req, httpResponse &res) {
+    if (uploadOwner != &req) {
+        res.send(409, "text/plain");
+        return;
+    }
+    uploadOwner = nullptr;
+    res.send(204, "text/plain");
+}
+
+httpServer *server;
+uint32_t    requestsBefore;
+uint32_t    connectionsBefore;
+
+void setUp() {
+    now = 0;
+    pending.clear();
+    uploaded.clear();
+    uploadEvents.clear();
+    uploadOwner = nullptr;
+    requestsBefore = metrics.http_requests_total.load();
+    connectionsBefore = metrics.http_connections_total.load();
+    server = new httpServer(acceptMock, fakeClock);
+    server->on("/hello", httpMethod::Get, handleHello);
+    server->on("/echo", httpMethod::Post, handleEcho);
+    server->on("/count", httpMethod::Get, handleCount);
+    server->on("/cached", httpMethod::Get, handleCached);
+    server->on("/big", httpMethod::Get, handleBig);
+    server->on("/secret", httpMethod::Get, handleSecret);
+    server->on("/upload", httpMethod::Post, handleUploadDone, handleUpload);
+    server->onNotFound(handleNotFound);
+}
+
+void tearDown() {
+    delete server;
+    peers.clear();
+}
+
+void test_http_get() {
+    mockPeer &c = connect("GET /hello?name=aura%20mon&x=1 HTTP/1.1\r\nHost: x\r\nX-Test:  yes \r\n"
+                          "Connection: close\r\n\r\n");
+    c.readMax = 7;
+
+    pollAll(*server);
+
+    TEST_ASSERT_TRUE(c.closed);
+    TEST_ASSERT_EQUAL(0, c.out.find("HTTP/1.1 200 OK\r\n"));
+    TEST_ASSERT_TRUE(c.out.find("Content-Length: 18\r\n") != std::string::npos);
+    TEST_ASSERT_TRUE(c.out.find("Access-Control-Allow-Origin: *\r\n") != std::string::npos);
+    TEST_ASSERT_EQUAL_STRING("hello aura mon yes", body(c.out).c_str());
+}
+
+void test_http_not_found() {
+    mockPeer &c = connect("GET /nope HTTP/1.1\r\n\r\n");
+
+    pollAll(*server, 1);
+
+    TEST_ASSERT_EQUAL(0, c.out.find("HTTP/1.1 404 Not Found\r\n"));
+    TEST_ASSERT_EQUAL_STRING("missing", body(c.out).c_str());
+}
+
+void test_http_post_body() {
+    mockPeer &c = connect("POST /echo HTTP/1.1\r\nContent-Length: 13\r\n\r\n{\"a\":[1,2,3]}");
+    c.readMax = 5;
+
+    pollAll(*server);
+
+    TEST_ASSERT_EQUAL_STRING("{\"a\":[1,2,3]}", body(c.out).c_str());
+}
+
+void test_http_stream_chunks() {
+    mockPeer &c = connect("GET /count HTTP/1.1\r\nConnection: close\r\n\r\n");
+
+    pollAll(*server);
+
+    std::string want;
+    for (int i = 1; i <= 1000; i++) {
+        want += std::to_string(i) + "\n";
+    }
+    TEST_ASSERT_TRUE(c.out.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+    TEST_ASSERT_TRUE(want == body(c.out));
+    TEST_ASSERT_TRUE(c.out.substr(c.out.size() - 5) == "0\r\n\r\n");
+    TEST_ASSERT_TRUE(counter.released);
+    TEST_ASSERT_TRUE(c.closed);
+
+    // Rows are gathered into full chunks.
+    const size_t headEnd = c.out.find("\r\n\r\n") + 4;
+    TEST_ASSERT_EQUAL(responseChunkSize, strtoul(c.out.c_str() + headEnd, nullptr, 16));
+}
+
+void test_http_stream_overrun_closes() {
+    mockPeer &c = connect("GET /big HTTP/1.1\r\n\r\n");
+
+    pollAll(*server);
+
+    // The response is abandoned rather than written past the send buffer.
+    TEST_ASSERT_TRUE(producedBig);
+    TEST_ASSERT_TRUE(c.closed);
+    TEST_ASSERT_TRUE(c.out.find("\r\n0\r\n\r\n") == std::string::npos);
+}
+
+void test_http_aborted_stream_discards_pending() {
+    mockPeer &a = connect("GET /secret HTTP/1.1\r\n\r\n");
+    pollAll(*server, 3);
+    TEST_ASSERT_TRUE(secretWritten);
+
+    a.open = false;
+    pollAll(*server, 1);
+    TEST_ASSERT_TRUE(a.closed);
+
+    // The next client on the freed connection gets none of the first one's bytes.
+    mockPeer &b = connect("GET /count HTTP/1.1\r\nConnection: close\r\n\r\n");
+    pollAll(*server);
+    TEST_ASSERT_TRUE(a.out.find("SECRET") == std::string::npos);
+    TEST_ASSERT_TRUE(b.out.find("SECRET") == std::string::npos);
+    TEST_ASSERT_EQUAL(0, body(b.out).find("1\n2\n"));
+}
+
+void test_http_slow_stream_does_not_block() {
+    mockPeer &slow = connect("GET /count HTTP/1.1\r\n\r\n");
+    slow.writeMax = 0;
+    pollAll(*server, 3);
+
+    mockPeer &fast = connect("GET /hello?name=b HTTP/1.1\r\nConnection: close\r\n\r\n");
+    pollAll(*server, 3);
+
+    TEST_ASSERT_EQUAL_STRING("hello b ?", body(fast.out).c_str());
+    TEST_ASSERT_EQUAL(1, server->connections());
+    TEST_ASSERT_FALSE(counter.released);
+
+    // A client that stops reading is dropped after the send timeout.
+    now += httpSendTimeoutMs + 1;
+    pollAll(*server, 1);
+    TEST_ASSERT_EQUAL(0, server->connections());
+    TEST_ASSERT_TRUE(counter.released);
+    TEST_ASSERT_TRUE(slow.closed);
+}
+
+void test_http_connection_limit() {
+    mockPeer *c[httpMaxConnections + 1];
+    for (auto &peer: c) {
+        peer = &connect("GET /hello HTTP/1.1\r\n"); // Never finishes its head.
+    }
+    pollAll(*server, 2);
+
+    // The last client waits to be accepted.
+    TEST_ASSERT_EQUAL(httpMaxConnections, server->connections());
+    TEST_ASSERT_EQUAL(1, pending.size());
+
+    // Idle clients time out and make room.
+    now += httpReadTimeoutMs + 1;
+    pollAll(*server, 2);
+    TEST_ASSERT_EQUAL(1, server->connections());
+    TEST_ASSERT_EQUAL(0, pending.size());
+    TEST_ASSERT_TRUE(c[0]->closed);
+}
+
+void test_http_multipart_upload() {
+    std::string content;
+    for (int i = 0; i < 3000; i++) {
+        content += static_cast<char>('a' + i % 26);
+    }
+    // Looks like the start of a delimiter but is not.
+    content += "\r\n--XyZ";
+    content += "tail";
+
+    std::string payload = "--XyZzY\r\n"
+                          "Content-Disposition: form-data; name=\"note\"\r\n\r\n"
+                          "ignored\r\n"
+                          "--XyZzY\r\n"
+                          "Content-Disposition: form-data; name=\"file\"; filename=\"index.html\"\r\n"
+                          "Content-Type: text/html\r\n\r\n" +
+                          content + "\r\n--XyZzY--\r\n";
+
+    mockPeer &c = connect("POST /upload HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=XyZzY\r\n"
+                          "Content-Length: " + std::to_string(payload.size()) + "\r\n\r\n" + payload);
+    c.readMax = 100;
+
+    pollAll(*server, 200);
+
+    TEST_ASSERT_EQUAL_STRING(("start:file:index.html end:" + std::to_string(content.size()) + " ").c_str(),
+                             uploadEvents.c_str());
+    TEST_ASSERT_TRUE(uploaded == content);
+    TEST_ASSERT_EQUAL(0, c.out.find("HTTP/1.1 204 No Content\r\n"));
+}
+
+void test_http_upload_aborted() {
+    mockPeer &c = connect("POST /upload HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=B\r\n"
+                          "Content-Length: 1000\r\n\r\n"
+                          "--B\r\nContent-Disposition: form-data; name=\"file\"; filename=\"f\"\r\n\r\npartial");
+    pollAll(*server, 3);
+
+    c.open = false;
+    pollAll(*server, 1);
+
+    TEST_ASSERT_EQUAL_STRING("start:file:f aborted ", uploadEvents.c_str());
+    TEST_ASSERT_EQUAL(0, server->connections());
+}
+
+void test_http_upload_aborted_after_end() {
+    // The file part ended, but the client leaves before the closing delimiter.
+    mockPeer &a = connect("POST /upload HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=B\r\n"
+                          "Content-Length: 1000\r\n\r\n"
+                          "--B\r\nContent-Disposition: form-data; name=\"file\"; filename=\"f\"\r\n\r\n"
+                          "data\r\n--B\r\nContent-Disposition: form-data; name=\"note\"\r\n\r\nmore");
+    pollAll(*server, 3);
+    TEST_ASSERT_EQUAL_STRING("start:file:f end:4 ", uploadEvents.c_str());
+
+    a.open = false;
+    now += httpReadTimeoutMs + 1;
+    pollAll(*server, 1);
+    TEST_ASSERT_EQUAL_STRING("start:file:f end:4 aborted ", uploadEvents.c_str());
+    TEST_ASSERT_NULL(uploadOwner);
+
+    // A later upload is not refused.
+    uploadEvents.clear();
+    const std::string payload = "--B\r\nContent-Disposition: form-data; name=\"file\"; filename=\"g\"\r\n\r\n"
+                                "next\r\n--B--\r\n";
+    mockPeer &b = connect("POST /upload HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=B\r\n"
+                          "Content-Length: " + std::to_string(payload.size()) + "\r\n\r\n" + payload);
+    pollAll(*server);
+    TEST_ASSERT_EQUAL_STRING("start:file:g end:4 ", uploadEvents.c_str());
+    TEST_ASSERT_EQUAL(0, b.out.find("HTTP/1.1 204 No Content\r\n"));
+}
+
+// responses splits everything sent on a connection into its responses.
+std::vector<std::string> responses(const std::string &out) {
+    std::vector<std::string> all;
+    size_t                   pos = 0;
+    while (pos < out.size()) {
+        const size_t headEnd = out.find("\r\n\r\n", pos) + 4;
+        const size_t length = out.find("Content-Length: ", pos);
+        size_t       end;
+        if (length != std::string::npos && length < headEnd) {
+            end = headEnd + strtoul(out.c_str() + length + 16, nullptr, 10);
+        } else if (out.find("Transfer-Encoding: chunked", pos) < headEnd) {
+            end = out.find("\r\n0\r\n\r\n", headEnd) + 7;
+        } else {
+            end = headEnd;
+        }
+        all.push_back(out.substr(pos, end - pos));
+        pos = end;
+    }
+    return all;
+}
+
+void test_http_keep_alive() {
+    mockPeer &c = connect("GET /hello?name=a HTTP/1.1\r\n\r\n");
+    pollAll(*server, 3);
+
+    TEST_ASSERT_TRUE(c.out.find("Connection: keep-alive\r\n") != std::string::npos);
+    TEST_ASSERT_EQUAL_STRING("hello a ?", body(c.out).c_str());
+    TEST_ASSERT_FALSE(c.closed);
+    TEST_ASSERT_EQUAL(1, server->connections());
+
+    // The next request reuses the connection, and so does one after a stream.
+    c.in += "GET /count HTTP/1.1\r\n\r\n";
+    pollAll(*server);
+    c.in += "GET /hello?name=b HTTP/1.1\r\n\r\n";
+    pollAll(*server, 3);
+
+    auto all = responses(c.out);
+    TEST_ASSERT_EQUAL(3, all.size());
+    TEST_ASSERT_TRUE(counter.released);
+    TEST_ASSERT_EQUAL_STRING("hello b ?", body(all[2]).c_str());
+    TEST_ASSERT_FALSE(c.closed);
+    TEST_ASSERT_EQUAL(3, metrics.http_requests_total.load() - requestsBefore);
+    TEST_ASSERT_EQUAL(1, metrics.http_connections_total.load() - connectionsBefore);
+
+    // Idle connections are closed after a while.
+    now += httpIdleTimeoutMs + 1;
+    pollAll(*server, 1);
+    TEST_ASSERT_TRUE(c.closed);
+}
+
+void test_http_pipelining() {
+    mockPeer &c = connect("GET /hello?name=a HTTP/1.1\r\n\r\n"
+                          "POST /echo HTTP/1.1\r\nContent-Length: 4\r\n\r\nabcd"
+                          "GET /nope HTTP/1.1\r\n\r\n"
+                          "GET /hello?name=b HTTP/1.1\r\nConnection: close\r\n\r\n");
+
+    pollAll(*server);
+
+    // Answered in order, then closed as the last request asked.
+    auto all = responses(c.out);
+    TEST_ASSERT_EQUAL(4, all.size());
+    TEST_ASSERT_EQUAL_STRING("hello a ?", body(all[0]).c_str());
+    TEST_ASSERT_EQUAL_STRING("abcd", body(all[1]).c_str());
+    TEST_ASSERT_EQUAL(0, all[2].find("HTTP/1.1 404 Not Found\r\n"));
+    TEST_ASSERT_EQUAL_STRING("hello b ?", body(all[3]).c_str());
+    TEST_ASSERT_TRUE(all[3].find("Connection: close\r\n") != std::string::npos);
+    TEST_ASSERT_TRUE(c.closed);
+}
+
+void test_http_post_large_body() {
+    // Too big to read in place behind the head.
+    const std::string data(httpRequestSize + 100, 'x');
+    mockPeer &c = connect("POST /echo HTTP/1.1\r\nContent-Length: " + std::to_string(data.size()) + "\r\n\r\n" + data +
+                          "GET /hello?name=next HTTP/1.1\r\n\r\n");
+
+    pollAll(*server);
+
+    auto all = responses(c.out);
+    TEST_ASSERT_EQUAL(2, all.size());
+    TEST_ASSERT_TRUE(data == body(all[0]));
+    TEST_ASSERT_EQUAL_STRING("hello next ?", body(all[1]).c_str());
+}
+
+void test_http_not_modified() {
+    mockPeer &c = connect("GET /cached HTTP/1.1\r\nIf-None-Match: \"1\"\r\n\r\n"
+                          "GET /cached HTTP/1.1\r\n\r\n");
+
+    pollAll(*server);
+
+    // A 304 has no body, the next response follows its head.
+    auto all = responses(c.out);
+    TEST_ASSERT_EQUAL(2, all.size());
+    TEST_ASSERT_EQUAL(0, all[0].find("HTTP/1.1 304 Not Modified\r\n"));
+    TEST_ASSERT_TRUE(all[0].find("Content-Length") == std::string::npos);
+    TEST_ASSERT_TRUE(all[0].find("ETag: \"1\"\r\n") != std::string::npos);
+    TEST_ASSERT_EQUAL_STRING("cached", body(all[1]).c_str());
+    TEST_ASSERT_FALSE(c.closed);
+}
+
+void test_http_http10_closes() {
+    mockPeer &plain = connect("GET /hello HTTP/1.0\r\n\r\n");
+    mockPeer &kept = connect("GET /hello HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n");
+    mockPeer &streamed = connect("GET /count HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    pollAll(*server);
+
+    TEST_ASSERT_TRUE(plain.closed);
+    TEST_ASSERT_FALSE(kept.closed);
+    TEST_ASSERT_TRUE(kept.out.find("Connection: keep-alive\r\n") != std::string::npos);
+    // Without chunks the end of the body is the connection closing.
+    TEST_ASSERT_TRUE(streamed.closed);
+    TEST_ASSERT_TRUE(streamed.out.find("Connection: close\r\n") != std::string::npos);
+}
+
+void test_http_idle_evicted() {
+    mockPeer *idle[httpMaxConnections];
+    for (auto &peer: idle) {
+        peer = &connect("GET /hello HTTP/1.1\r\n\r\n");
+        pollAll(*server, 2);
+        now += 10;
+    }
+    TEST_ASSERT_EQUAL(httpMaxConnections, server->connections());
+
+    // A new client takes the slot of the connection idle the longest.
+    mockPeer &c = connect("GET /hello?name=new HTTP/1.1\r\n\r\n");
+    pollAll(*server, 2);
+
+    TEST_ASSERT_EQUAL_STRING("hello new ?", body(c.out).c_str());
+    TEST_ASSERT_TRUE(idle[0]->closed);
+    TEST_ASSERT_FALSE(idle[1]->closed);
+    TEST_ASSERT_EQUAL(httpMaxConnections, server->connections());
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_http_get);
+    RUN_TEST(test_http_not_found);
+    RUN_TEST(test_http_post_body);
+    RUN_TEST(test_http_stream_chunks);
+    RUN_TEST(test_http_stream_overrun_closes);
+    RUN_TEST(test_http_aborted_stream_discards_pending);
+    RUN_TEST(test_http_slow_stream_does_not_block);
+    RUN_TEST(test_http_connection_limit);
+    RUN_TEST(test_http_multipart_upload);
+    RUN_TEST(test_http_upload_aborted);
+    RUN_TEST(test_http_upload_aborted_after_end);
+    RUN_TEST(test_http_keep_alive);
+    RUN_TEST(test_http_pipelining);
+    RUN_TEST(test_http_post_large_body);
+    RUN_TEST(test_http_not_modified);
+    RUN_TEST(test_http_http10_closes);
+    RUN_TEST(test_http_idle_evicted);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
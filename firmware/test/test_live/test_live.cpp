@@ -0,0 +1,200 @@
+//
+// Unit tests for the /live server-sent event feed
+//
+
+#include <unity.h>
+#include <string>
+#include "../test/stubs/TestAuraMon.h"
+#include "../../src/live.h"
+
+struct capture {
+    std::string out;
+    int         chunks = 0;
+};
+
+void captureChunk(void *ctx, const char *data, size_t len) {
+    auto c = static_cast<capture *>(ctx);
+    c->out.append(data, len);
+    c->chunks++;
+}
+
+// drain runs the producer until the frame in progress has been flushed.
+void drain(liveClient *client, responseWriter &w, int calls = 100) {
+    for (int i = 0; i < calls; i++) {
+        produceLive(client, w);
+        if (!client->frame && w.pending() == 0) {
+            return;
+        }
+    }
+}
+
+void publish(uint32_t ms, float volts) {
+    liveData data{};
+    data.ms = ms;
+    data.channels[0] = channelReading{volts, 1.5f, 0.9f, 50.0f};
+    data.channels[3] = channelReading{NAN, 0, 0, 0};
+    live.publish(data);
+}
+
+void setUp() {
+    deviceInfos[0] = new inputDeviceInfo(0, 1);
+    deviceInfos[0]->name = "Geyser \"main\"";
+    deviceInfos[1] = new inputDeviceInfo(3, 4);
+    deviceInfos[1]->name = "Pool";
+    deviceInfos[2] = new inputDeviceInfo(5, 6); // No name, not shown.
+}
+
+void tearDown() {
+    for (auto &info: deviceInfos) {
+        delete info;
+        info = nullptr;
+    }
+}
+
+void test_live_frame() {
+    publish(1000, 230.25f);
+    const uint32_t version = live.version();
+
+    capture        cap;
+    responseWriter w(captureChunk, &cap);
+    liveClient *   client = openLiveClient();
+    drain(client, w);
+
+    const std::string want = "id: " + std::to_string(version) + "\n"
+                             "data: {\"ms\":1000,\"devices\":["
+                             "{\"name\":\"Geyser \\\"main\\\"\",\"volts\":230.25,\"amps\":1.500,\"pf\":0.900,\"hz\":50.00},"
+                             "{\"name\":\"Pool\",\"volts\":null,\"amps\":0.000,\"pf\":0.000,\"hz\":0.00}]}\n\n";
+    TEST_ASSERT_EQUAL_STRING(want.c_str(), cap.out.c_str());
+    TEST_ASSERT_EQUAL(1, cap.chunks);
+
+    // Nothing more until the next sample.
+    produceLive(client, w);
+    TEST_ASSERT_EQUAL(0, w.pending());
+
+    releaseLive(client);
+}
+
+void test_live_shared_frame() {
+    const uint32_t before = metrics.live_frames_total.load();
+    publish(2000, 231);
+
+    capture        a, b;
+    responseWriter wa(captureChunk, &a);
+    responseWriter wb(captureChunk, &b);
+    liveClient *   ca = openLiveClient();
+    liveClient *   cb = openLiveClient();
+    drain(ca, wa);
+    drain(cb, wb);
+
+    TEST_ASSERT_TRUE(a.out == b.out);
+    TEST_ASSERT_EQUAL(1, metrics.live_frames_total.load() - before);
+
+    // A new sample is encoded once more, for both.
+    publish(3000, 232);
+    drain(ca, wa);
+    drain(cb, wb);
+    TEST_ASSERT_TRUE(a.out == b.out);
+    TEST_ASSERT_TRUE(a.out.find("\"ms\":3000") != std::string::npos);
+    TEST_ASSERT_EQUAL(2, metrics.live_frames_total.load() - before);
+
+    releaseLive(ca);
+    releaseLive(cb);
+}
+
+void test_live_frame_outlives_sample() {
+    publish(4000, 233);
+
+    capture        cap;
+    responseWriter w(captureChunk, &cap);
+    liveClient *   client = openLiveClient();
+
+    // A sample arrives while the frame is half sent, it still goes out whole.
+    produceLive(client, w);
+    TEST_ASSERT_NOT_NULL(client->frame);
+    publish(5000, 234);
+    drain(client, w);
+    TEST_ASSERT_TRUE(cap.out.find("\"ms\":4000") != std::string::npos);
+    TEST_ASSERT_TRUE(cap.out.find("\"ms\":5000") == std::string::npos);
+
+    drain(client, w);
+    TEST_ASSERT_TRUE(cap.out.find("\"ms\":5000") != std::string::npos);
+
+    releaseLive(client);
+}
+
+void test_live_client_limit() {
+    liveClient *clients[liveMaxClients];
+    for (auto &c: clients) {
+        c = openLiveClient();
+        TEST_ASSERT_NOT_NULL(c);
+    }
+    TEST_ASSERT_NULL(openLiveClient());
+    TEST_ASSERT_EQUAL(liveMaxClients, liveClients());
+
+    releaseLive(clients[0]);
+    clients[0] = openLiveClient();
+    TEST_ASSERT_NOT_NULL(clients[0]);
+
+    for (auto c: clients) {
+        releaseLive(c);
+    }
+    TEST_ASSERT_EQUAL(0, liveClients());
+}
+
+void test_live_heartbeat() {
+    publish(6000, 235);
+
+    capture        cap;
+    responseWriter w(captureChunk, &cap);
+    liveClient *   client = openLiveClient();
+    drain(client, w);
+    cap.out.clear();
+
+    // The test clock moves 10ms a call.
+    for (uint32_t i = 0; i < liveHeartbeatMs / 10 + 1 && cap.out.empty(); i++) {
+        produceLive(client, w);
+    }
+    TEST_ASSERT_EQUAL_STRING(":\n\n", cap.out.c_str());
+
+    releaseLive(client);
+}
+
+void test_live_acquire_frame() {
+    publish(7000, 236);
+
+    liveFrame *f = acquireLiveFrame();
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(live.version(), f->version);
+    const std::string devices(f->data + f->devicesStart, f->devicesLen);
+    TEST_ASSERT_EQUAL_STRING("[{\"name\":\"Geyser \\\"main\\\"\",\"volts\":236.00,\"amps\":1.500,\"pf\":0.900,\"hz\":50.00},"
+                             "{\"name\":\"Pool\",\"volts\":null,\"amps\":0.000,\"pf\":0.000,\"hz\":0.00}]",
+                             devices.c_str());
+
+    // The same frame is shared until the next sample.
+    liveFrame *again = acquireLiveFrame();
+    TEST_ASSERT_TRUE(f == again);
+    releaseLiveFrame(again);
+    releaseLiveFrame(f);
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_live_frame);
+    RUN_TEST(test_live_shared_frame);
+    RUN_TEST(test_live_frame_outlives_sample);
+    RUN_TEST(test_live_client_limit);
+    RUN_TEST(test_live_heartbeat);
+    RUN_TEST(test_live_acquire_frame);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
@@ -0,0 +1,98 @@
+//
+// Unit tests for the cross-core queue
+//
+
+#include <unity.h>
+#include <thread>
+#include "../../src/queue.h"
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_queue_fifo() {
+    spscQueue<uint32_t, 4> q;
+    uint32_t               v = 0;
+
+    TEST_ASSERT_FALSE(q.pop(v));
+    TEST_ASSERT_TRUE(q.push(1));
+    TEST_ASSERT_TRUE(q.push(2));
+    TEST_ASSERT_EQUAL(2, q.depth());
+
+    TEST_ASSERT_TRUE(q.pop(v));
+    TEST_ASSERT_EQUAL(1, v);
+    TEST_ASSERT_TRUE(q.pop(v));
+    TEST_ASSERT_EQUAL(2, v);
+    TEST_ASSERT_FALSE(q.pop(v));
+    TEST_ASSERT_EQUAL(0, q.depth());
+}
+
+void test_queue_full() {
+    spscQueue<uint32_t, 4> q;
+    uint32_t               v = 0;
+
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(q.push(i));
+    }
+    TEST_ASSERT_FALSE(q.push(4));
+    TEST_ASSERT_EQUAL(1, q.dropped());
+    TEST_ASSERT_EQUAL(4, q.highWater());
+
+    // Space is reused once the consumer catches up.
+    TEST_ASSERT_TRUE(q.pop(v));
+    TEST_ASSERT_EQUAL(0, v);
+    TEST_ASSERT_TRUE(q.push(5));
+    TEST_ASSERT_EQUAL(4, q.depth());
+}
+
+void test_queue_threads() {
+    constexpr uint32_t       count = 20000;
+    spscQueue<uint32_t, 8> q;
+
+    std::thread producer([&q] {
+        for (uint32_t i = 0; i < count;) {
+            if (q.push(i)) {
+                i++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t next = 0;
+    bool     ordered = true;
+    while (next < count) {
+        uint32_t v;
+        if (!q.pop(v)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ordered &= v == next;
+        next++;
+    }
+    producer.join();
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_TRUE(q.highWater() <= 8);
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_queue_fifo);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_queue_threads);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
@@ -0,0 +1,131 @@
+//
+// Unit tests for the chunked response writer
+//
+
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "../test/stubs/TestAuraMon.h"
+#include "../../src/response.h"
+
+std::vector<std::string> chunks;
+
+void captureChunk(void *ctx, const char *data, size_t len) {
+    (void) ctx;
+    chunks.emplace_back(data, len);
+}
+
+void setUp() {
+    chunks.clear();
+    metrics.http_chunks_total = 0;
+    metrics.http_chunk_bytes_total = 0;
+}
+
+void tearDown() {
+}
+
+void test_response_coalesces_rows() {
+    responseWriter w(captureChunk, nullptr);
+    const char     row[] = "1730000000,50.00,230.000,1.000\n";
+    const size_t   rowLen = sizeof(row) - 1;
+
+    for (int i = 0; i < 100; i++) {
+        w.write(row, rowLen);
+    }
+    w.flush();
+
+    // Rows are not split, so every chunk but the last holds as many as fit.
+    const size_t rowsPerChunk = responseChunkSize / rowLen;
+    TEST_ASSERT_EQUAL((100 + rowsPerChunk - 1) / rowsPerChunk, chunks.size());
+    size_t total = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (i + 1 < chunks.size()) {
+            TEST_ASSERT_TRUE(chunks[i].size() > responseChunkSize - rowLen);
+        }
+        total += chunks[i].size();
+    }
+    TEST_ASSERT_EQUAL(100 * rowLen, total);
+    TEST_ASSERT_EQUAL(chunks.size(), metrics.http_chunks_total.load());
+    TEST_ASSERT_EQUAL(total, metrics.http_chunk_bytes_total.load());
+}
+
+void test_response_large_write() {
+    responseWriter    w(captureChunk, nullptr);
+    const std::string big(responseChunkSize * 2, 'x');
+
+    w.write('a');
+    w.write(big.data(), big.size());
+    w.write('b');
+    w.flush();
+
+    // Buffered bytes go first, the big write is split into full chunks.
+    TEST_ASSERT_EQUAL(4, chunks.size());
+    TEST_ASSERT_EQUAL_STRING("a", chunks[0].c_str());
+    TEST_ASSERT_EQUAL(responseChunkSize, chunks[1].size());
+    TEST_ASSERT_EQUAL(responseChunkSize, chunks[2].size());
+    TEST_ASSERT_EQUAL_STRING("b", chunks[3].c_str());
+}
+
+void test_response_buffer_commit() {
+    responseWriter w(captureChunk, nullptr);
+    size_t         free;
+
+    char *p = w.buffer(1, &free);
+    TEST_ASSERT_EQUAL(responseChunkSize, free);
+    memset(p, 'y', free);
+    w.commit(free);
+    TEST_ASSERT_EQUAL(0, chunks.size());
+
+    // A full buffer is sent before more space is handed out.
+    w.buffer(1, &free);
+    TEST_ASSERT_EQUAL(1, chunks.size());
+    TEST_ASSERT_EQUAL(responseChunkSize, chunks[0].size());
+    TEST_ASSERT_EQUAL(responseChunkSize, free);
+}
+
+void test_response_discard() {
+    responseWriter w(captureChunk, nullptr);
+
+    w.write("dropped");
+    w.discard();
+    TEST_ASSERT_EQUAL(0, w.pending());
+    w.write("kept");
+    w.flush();
+
+    TEST_ASSERT_EQUAL(1, chunks.size());
+    TEST_ASSERT_EQUAL_STRING("kept", chunks[0].c_str());
+}
+
+void test_response_numbers() {
+    responseWriter w(captureChunk, nullptr);
+
+    w.writeUint(1730000000);
+    w.write(',');
+    w.writeFixed(230.1234, 3);
+    w.write(',');
+    w.writeFixed(NAN, 3);
+    w.flush();
+
+    TEST_ASSERT_EQUAL_STRING("1730000000,230.123,", chunks[0].c_str());
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_response_coalesces_rows);
+    RUN_TEST(test_response_large_write);
+    RUN_TEST(test_response_buffer_commit);
+    RUN_TEST(test_response_discard);
+    RUN_TEST(test_response_numbers);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
@@ -0,0 +1,208 @@
+//
+// Unit tests for the bus scan
+//
+
+#include <unity.h>
+#include <cstring>
+#include "../test/stubs/TestAuraMon.h"
+
+// meter answers probes at addr after us. The first garbled replies have a bad CRC.
+struct meter {
+    uint8_t  addr;
+    uint32_t us;
+    uint8_t  garbled;
+};
+
+std::vector<meter> meters;
+uint8_t            probes[248];
+uint32_t           probeTimeoutMs[248]; // Bus timeout of the last probe at each address.
+
+void answer(HardwareSerial &serial, const uint8_t *buf, size_t len) {
+    (void) len;
+    const uint8_t addr = buf[0];
+    probes[addr]++;
+    probeTimeoutMs[addr] = buses[0].timeout();
+
+    for (auto &m: meters) {
+        if (m.addr != addr) {
+            continue;
+        }
+
+        std::vector<uint8_t> frame{addr, 0x04, 0x04, 0x43, 0x66, 0x00, 0x00};
+        const uint16_t       crc = modbusCRC(frame.data(), frame.size());
+        frame.push_back(crc & 0xFF);
+        frame.push_back(crc >> 8);
+        if (m.garbled) {
+            m.garbled--;
+            frame[3] ^= 0xFF;
+        }
+        serial.rx.insert(serial.rx.end(), frame.begin(), frame.end());
+        serial.replyUS = m.us;
+    }
+}
+
+// finishScan runs the scan task until it publishes a finished scan.
+void finishScan() {
+    int calls = 0;
+    do {
+        scanTask(nullptr);
+    } while (scanResult.state != scanState::Done && ++calls < 1000);
+    TEST_ASSERT_TRUE(scanResult.state == scanState::Done);
+}
+
+void runScan() {
+    TEST_ASSERT_TRUE(startBusScan(0));
+    finishScan();
+}
+
+void setUp() {
+    busSerial.reset();
+    busSerial.onWrite = answer;
+    buses[0].begin(38400);
+    buses[0].setTimeout(60);
+
+    meters.clear();
+    memset(probes, 0, sizeof(probes));
+    memset(probeTimeoutMs, 0, sizeof(probeTimeoutMs));
+
+    deviceActionRequest req{};
+    while (c0Commands.pop(req)) {
+    }
+}
+
+void tearDown() {
+    for (auto &info: deviceInfos) {
+        if (info) {
+            free(const_cast<char *>(info->name));
+        }
+        delete info;
+        info = nullptr;
+    }
+}
+
+void test_scan_finds_meters() {
+    meters = {{3, 0, 0}, {200, 0, 0}};
+
+    TEST_ASSERT_TRUE(startBusScan(0));
+    TEST_ASSERT_FALSE(startBusScan(0));
+    finishScan();
+
+    TEST_ASSERT_EQUAL(2, scanResult.foundCount);
+    TEST_ASSERT_TRUE(scanResult.isFound(3));
+    TEST_ASSERT_TRUE(scanResult.isFound(200));
+    TEST_ASSERT_FALSE(scanResult.isFound(4));
+    for (uint16_t addr = 1; addr <= 247; addr++) {
+        TEST_ASSERT_EQUAL(1, probes[addr]);
+    }
+    TEST_ASSERT_EQUAL(0, probes[0]);
+
+    // The bus goes back to its own timeout between slices.
+    TEST_ASSERT_EQUAL(60, buses[0].timeout());
+}
+
+void test_scan_timeout_adapts() {
+    meters = {{2, 5000, 0}};
+
+    runScan();
+
+    // Nothing is known before the first reply, so the longest timeout is used.
+    TEST_ASSERT_EQUAL(MODBUS_SCAN_MAX_TIMEOUT_MS, probeTimeoutMs[1]);
+    TEST_ASSERT_EQUAL(MODBUS_SCAN_MAX_TIMEOUT_MS, probeTimeoutMs[2]);
+
+    // Then twice the slowest reply.
+    TEST_ASSERT_TRUE(scanResult.maxResponseUS >= 5000);
+    TEST_ASSERT_EQUAL(scanResult.maxResponseUS * 2 / 1000 + 1, scanResult.timeoutMs);
+    TEST_ASSERT_EQUAL(scanResult.timeoutMs, probeTimeoutMs[3]);
+    TEST_ASSERT_EQUAL(scanResult.timeoutMs, probeTimeoutMs[247]);
+}
+
+void test_scan_timeout_clamped() {
+    meters = {{2, 0, 0}};
+    runScan();
+    TEST_ASSERT_EQUAL(MODBUS_SCAN_MIN_TIMEOUT_MS, scanResult.timeoutMs);
+    TEST_ASSERT_EQUAL(MODBUS_SCAN_MIN_TIMEOUT_MS, probeTimeoutMs[3]);
+
+    setUp();
+    meters = {{2, 40000, 0}};
+    runScan();
+    TEST_ASSERT_EQUAL(MODBUS_SCAN_MAX_TIMEOUT_MS, scanResult.timeoutMs);
+    TEST_ASSERT_EQUAL(MODBUS_SCAN_MAX_TIMEOUT_MS, probeTimeoutMs[3]);
+}
+
+void test_scan_retries_garbled() {
+    meters = {{2, 0, 0}, {7, 0, 1}, {9, 0, 2}};
+
+    runScan();
+
+    // A garbled reply is probed once more with the longest timeout.
+    TEST_ASSERT_EQUAL(2, probes[7]);
+    TEST_ASSERT_TRUE(scanResult.isFound(7));
+    TEST_ASSERT_EQUAL(2, probes[9]);
+    TEST_ASSERT_EQUAL(MODBUS_SCAN_MAX_TIMEOUT_MS, probeTimeoutMs[9]);
+    TEST_ASSERT_FALSE(scanResult.isFound(9));
+
+    // Silence is not retried.
+    TEST_ASSERT_EQUAL(1, probes[8]);
+    TEST_ASSERT_EQUAL(2, scanResult.foundCount);
+}
+
+void test_scan_merges_channels() {
+    deviceInfos[0] = new inputDeviceInfo(0, 3);
+    deviceInfos[0]->name = strdup("Main");
+    meters = {{3, 0, 0}, {7, 0, 0}, {12, 0, 0}};
+
+    runScan();
+
+    // Configured meters are kept, new ones take the free channels in address order.
+    TEST_ASSERT_EQUAL(3, deviceInfos[0]->addr);
+    TEST_ASSERT_EQUAL_STRING("Main", deviceInfos[0]->name);
+    TEST_ASSERT_NOT_NULL(deviceInfos[1]);
+    TEST_ASSERT_EQUAL(1, deviceInfos[1]->channel);
+    TEST_ASSERT_EQUAL(7, deviceInfos[1]->addr);
+    TEST_ASSERT_EQUAL(0, deviceInfos[1]->bus);
+    TEST_ASSERT_TRUE(deviceInfos[1]->enabled);
+    TEST_ASSERT_EQUAL_STRING("Device 7", deviceInfos[1]->name);
+    TEST_ASSERT_NOT_NULL(deviceInfos[2]);
+    TEST_ASSERT_EQUAL(12, deviceInfos[2]->addr);
+    TEST_ASSERT_NULL(deviceInfos[3]);
+
+    // Core 0 is asked to save the config.
+    deviceActionRequest req{};
+    TEST_ASSERT_TRUE(c0Commands.pop(req));
+    TEST_ASSERT_TRUE(req.type == deviceActionType::Save);
+    TEST_ASSERT_FALSE(c0Commands.pop(req));
+}
+
+void test_scan_merges_nothing_known() {
+    deviceInfos[0] = new inputDeviceInfo(0, 3);
+    deviceInfos[0]->name = strdup("Main");
+    meters = {{3, 0, 0}};
+
+    runScan();
+
+    TEST_ASSERT_NULL(deviceInfos[1]);
+    deviceActionRequest req{};
+    TEST_ASSERT_FALSE(c0Commands.pop(req));
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_scan_finds_meters);
+    RUN_TEST(test_scan_timeout_adapts);
+    RUN_TEST(test_scan_timeout_clamped);
+    RUN_TEST(test_scan_retries_garbled);
+    RUN_TEST(test_scan_merges_channels);
+    RUN_TEST(test_scan_merges_nothing_known);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
@@ -0,0 +1,88 @@
+//
+// Unit tests for the lock free snapshot between the cores
+//
+
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "../../src/snapshot.h"
+
+struct sample {
+    uint32_t values[64];
+};
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_snapshot_version() {
+    snapshot<sample> s;
+    TEST_ASSERT_EQUAL(0, s.version());
+
+    sample v{};
+    v.values[0] = 7;
+    s.publish(v);
+    TEST_ASSERT_EQUAL(1, s.version());
+    TEST_ASSERT_EQUAL(7, s.read().values[0]);
+
+    v.values[0] = 8;
+    s.publish(v);
+    TEST_ASSERT_EQUAL(2, s.version());
+    TEST_ASSERT_EQUAL(8, s.read().values[0]);
+}
+
+void test_snapshot_never_torn() {
+    snapshot<sample>  s;
+    std::atomic<bool> done{false};
+
+    // The writer publishes as fast as it can, every value all one number.
+    std::thread writer([&] {
+        sample v{};
+        for (uint32_t n = 1; n <= 200000; n++) {
+            for (auto &x: v.values) {
+                x = n;
+            }
+            s.publish(v);
+        }
+        done = true;
+    });
+
+    uint32_t torn = 0;
+    uint32_t last = 0;
+    while (!done) {
+        const sample v = s.read();
+        for (const auto x: v.values) {
+            if (x != v.values[0]) {
+                torn++;
+                break;
+            }
+        }
+        // Reads never go back in time.
+        TEST_ASSERT_TRUE(v.values[0] >= last);
+        last = v.values[0];
+    }
+    writer.join();
+
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL(200000, s.read().values[0]);
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_snapshot_version);
+    RUN_TEST(test_snapshot_never_torn);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}
@@ -0,0 +1,283 @@
+//
+// Unit tests for the task scheduler
+//
+
+#include <unity.h>
+#include "../test/stubs/TestAuraMon.h"
+#include "../../src/task.h"
+
+uint32_t now;
+char     order[16];
+uint8_t  orderLen;
+
+uint32_t fakeClock() {
+    return now;
+}
+
+uint32_t taskA(void *param) {
+    (void) param;
+    order[orderLen++] = 'A';
+    return 100;
+}
+
+uint32_t taskB(void *param) {
+    (void) param;
+    order[orderLen++] = 'B';
+    return 50;
+}
+
+uint32_t taskOnce(void *param) {
+    (void) param;
+    order[orderLen++] = 'O';
+    return 0;
+}
+
+resumable steps;
+bool      ready;
+uint8_t   restarts;
+
+uint32_t taskWaiting(void *param) {
+    (void) param;
+    TASK_BEGIN(steps);
+    order[orderLen++] = 'W';
+    TASK_WAIT_UNTIL(steps, ready, 10);
+    order[orderLen++] = 'D';
+    TASK_END(steps);
+    return 0;
+}
+
+uint32_t taskSleeping(void *param) {
+    (void) param;
+    TASK_BEGIN(steps);
+    order[orderLen++] = 'S';
+    TASK_SLEEP(steps, 200);
+    order[orderLen++] = 'D';
+    TASK_END(steps);
+    return 0;
+}
+
+uint32_t taskRestarting(void *param) {
+    (void) param;
+    TASK_BEGIN(steps);
+    order[orderLen++] = 'R';
+    if (restarts++ == 0) {
+        TASK_RESTART(steps, 30);
+    }
+    order[orderLen++] = 'D';
+    TASK_END(steps);
+    return 0;
+}
+
+void setUp() {
+    now = 0;
+    orderLen = 0;
+    memset(order, 0, sizeof(order));
+    steps = resumable{};
+    ready = false;
+    restarts = 0;
+}
+
+void tearDown() {
+}
+
+void test_task_priority_order() {
+    taskQueue q(fakeClock);
+    q.add(taskA, 4, "taskA");
+    q.add(taskB, 6, "taskB");
+
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_FALSE(q.runNextTask());
+    TEST_ASSERT_EQUAL_STRING("BA", order);
+}
+
+void test_task_deadlines() {
+    taskQueue q(fakeClock);
+    q.add(taskA, 4, "taskA");
+    q.add(taskB, 4, "taskB");
+    while (q.runNextTask()) {
+    }
+
+    now = 50;
+    TEST_ASSERT_TRUE(q.runNextTask()); // B
+    TEST_ASSERT_FALSE(q.runNextTask());
+
+    now = 100;
+    TEST_ASSERT_TRUE(q.runNextTask()); // A and B are both due, same priority.
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_FALSE(q.runNextTask());
+    TEST_ASSERT_EQUAL(5, orderLen);
+}
+
+void test_task_removed_when_done() {
+    taskQueue q(fakeClock);
+    q.add(taskOnce, 4, "taskOnce");
+
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_EQUAL(0, q.size());
+    now = 1000;
+    TEST_ASSERT_FALSE(q.runNextTask());
+}
+
+void test_task_rollover() {
+    taskQueue q(fakeClock);
+    now = 0xFFFFFFF0;
+    q.add(taskA, 4, "taskA");
+    q.add(taskB, 4, "taskB");
+    while (q.runNextTask()) {
+    }
+    orderLen = 0;
+
+    // B is due at 0x22 and A at 0x54, past the rollover.
+    now = 0xFFFFFFFF;
+    TEST_ASSERT_FALSE(q.runNextTask());
+    now = 0x22;
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_FALSE(q.runNextTask());
+    now = 0x54;
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_EQUAL_STRING_LEN("BA", order, 2);
+}
+
+void test_task_full() {
+    taskQueue q(fakeClock);
+    for (uint8_t i = 0; i < taskQueue::maxTasks; i++) {
+        TEST_ASSERT_TRUE(q.add(taskA, 4, "taskA"));
+    }
+    TEST_ASSERT_FALSE(q.add(taskA, 4, "taskA"));
+}
+
+void test_task_stats() {
+    taskQueue q(fakeClock);
+    q.add(taskA, 4, "taskA");
+    q.runNextTask();
+
+    // Due at 100, started 30ms late.
+    now = 130;
+    q.runNextTask();
+
+    const taskStats *s = q.stats("taskA");
+    TEST_ASSERT_EQUAL(1, q.statsCount());
+    TEST_ASSERT_EQUAL(2, s->runs.load());
+    TEST_ASSERT_EQUAL(1, s->late[0].load());
+    TEST_ASSERT_EQUAL(1, s->late[3].load()); // Up to 50ms.
+    TEST_ASSERT_EQUAL(30, s->lateMs.load());
+}
+
+void test_task_idle() {
+    taskQueue q(fakeClock);
+    q.idle(10);
+    delayMicroseconds(2000);
+    q.idle(10);
+
+    // The mock clock adds a little to every reading.
+    TEST_ASSERT_UINT64_WITHIN(1000, 20000, q.load().idleUS.load());
+    TEST_ASSERT_UINT64_WITHIN(1000, 2000, q.load().busyUS.load());
+}
+
+void test_task_idle_returns_when_due() {
+    taskQueue q(fakeClock);
+    q.add(taskA, 4, "taskA");
+
+    const uint64_t idle = q.load().idleUS.load();
+    q.idle(10);
+    TEST_ASSERT_EQUAL(idle, q.load().idleUS.load());
+    TEST_ASSERT_EQUAL(0, q.nextDelay());
+}
+
+void test_task_notify() {
+    taskQueue q(fakeClock);
+    q.add(taskA, 4, "taskA");
+    q.addOnNotify(taskB, 4, "taskB");
+    while (q.runNextTask()) {
+    }
+    orderLen = 0;
+
+    now = 10;
+    TEST_ASSERT_FALSE(q.runNextTask());
+
+    q.notify();
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_FALSE(q.runNextTask());
+    TEST_ASSERT_EQUAL_STRING_LEN("B", order, 1);
+}
+
+void test_task_wait_until() {
+    taskQueue q(fakeClock);
+    q.add(taskWaiting, 4, "taskWaiting");
+
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_EQUAL(10, q.nextDelay());
+
+    // The wait is checked again each time the task runs, without restarting it.
+    now = 10;
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_EQUAL_STRING("W", order);
+
+    ready = true;
+    now = 20;
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_EQUAL_STRING("WD", order);
+    TEST_ASSERT_EQUAL(0, q.size());
+    TEST_ASSERT_EQUAL(0, steps.line);
+}
+
+void test_task_sleep() {
+    taskQueue q(fakeClock);
+    now = 1000;
+    q.add(taskSleeping, 4, "taskSleeping");
+
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_EQUAL(1000, steps.since);
+    TEST_ASSERT_EQUAL(200, q.nextDelay());
+
+    // The sleep follows the queue's clock, not millis().
+    now = 1199;
+    TEST_ASSERT_FALSE(q.runNextTask());
+    now = 1200;
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_EQUAL_STRING("SD", order);
+    TEST_ASSERT_EQUAL(0, q.size());
+}
+
+void test_task_restart() {
+    taskQueue q(fakeClock);
+    q.add(taskRestarting, 4, "taskRestarting");
+
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_EQUAL(0, steps.line);
+    TEST_ASSERT_EQUAL(30, q.nextDelay());
+
+    now = 30;
+    TEST_ASSERT_TRUE(q.runNextTask());
+    TEST_ASSERT_EQUAL_STRING("RRD", order);
+    TEST_ASSERT_EQUAL(0, q.size());
+}
+
+void setup() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_task_priority_order);
+    RUN_TEST(test_task_deadlines);
+    RUN_TEST(test_task_removed_when_done);
+    RUN_TEST(test_task_rollover);
+    RUN_TEST(test_task_full);
+    RUN_TEST(test_task_stats);
+    RUN_TEST(test_task_idle);
+    RUN_TEST(test_task_idle_returns_when_due);
+    RUN_TEST(test_task_notify);
+    RUN_TEST(test_task_wait_until);
+    RUN_TEST(test_task_sleep);
+    RUN_TEST(test_task_restart);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Nothing to do here
+}
+
+int main(int argc, char **argv) {
+    setup();
+    return 0;
+}